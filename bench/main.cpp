@@ -0,0 +1,336 @@
+#include <QApplication>
+#include <QList>
+#include <QStringList>
+#include <QTextStream>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include <QtMultiSpinBox>
+#include <QtMultiSpinBoxElements>
+
+
+// Memory used by shown QtMultiSpinBox widgets on the demo layouts (line
+// edit, private validator, elements, section data...). On glibc every
+// malloc of the process is counted (operator new and the Qt containers
+// end there) and the heap in use is read; elsewhere only operator new is
+// counted, with its bytes.
+
+namespace {
+
+std::atomic<long long> g_allocations(0);
+std::atomic<long long> g_liveBlocks(0);
+
+inline void countAllocation(bool newBlock)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (newBlock)
+        g_liveBlocks.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void countFree()
+{
+    g_liveBlocks.fetch_sub(1, std::memory_order_relaxed);
+}
+
+} // namespace
+
+
+#if defined(__GLIBC__)
+
+// the executable comes first in the symbol lookup: Qt and libstdc++ use
+// these, which forward to the glibc allocator
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void __libc_free(void* p);
+
+void* malloc(size_t size) __THROW
+{
+    void* p = __libc_malloc(size);
+    if (p)
+        countAllocation(true);
+    return p;
+}
+
+void* calloc(size_t count, size_t size) __THROW
+{
+    void* p = __libc_calloc(count, size);
+    if (p)
+        countAllocation(true);
+    return p;
+}
+
+void* realloc(void* p, size_t size) __THROW
+{
+    if (p && size == 0) {
+        countFree();
+        return __libc_realloc(p, size);
+    }
+    void* q = __libc_realloc(p, size);
+    if (q)
+        countAllocation(!p);
+    return q;
+}
+
+void free(void* p) __THROW
+{
+    if (p)
+        countFree();
+    __libc_free(p);
+}
+
+} // extern "C"
+
+static const char* const allocator = "malloc";
+static long long newBytesInUse() { return -1; }
+
+#else
+
+namespace {
+
+const std::size_t HeaderSize = 16; // size of the block, keeps the malloc alignment
+
+std::atomic<long long> g_newBytes(0);
+
+void* countedAlloc(std::size_t size)
+{
+    char* block = static_cast<char*>(std::malloc(size + HeaderSize));
+    if (!block)
+        return 0;
+    *reinterpret_cast<std::size_t*>(block) = size;
+    countAllocation(true);
+    g_newBytes.fetch_add((long long)size, std::memory_order_relaxed);
+    return block + HeaderSize;
+}
+
+void countedFree(void* p)
+{
+    if (!p)
+        return;
+    char* block = static_cast<char*>(p) - HeaderSize;
+    countFree();
+    g_newBytes.fetch_sub((long long)*reinterpret_cast<std::size_t*>(block), std::memory_order_relaxed);
+    std::free(block);
+}
+
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    void* p = countedAlloc(size);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    void* p = countedAlloc(size);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+void operator delete(void* p) noexcept { countedFree(p); }
+void operator delete[](void* p) noexcept { countedFree(p); }
+void operator delete(void* p, std::size_t) noexcept { countedFree(p); }
+void operator delete[](void* p, std::size_t) noexcept { countedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { countedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { countedFree(p); }
+
+static const char* const allocator = "operator new";
+static long long newBytesInUse() { return g_newBytes.load(); }
+
+#endif
+
+
+// -1 if unknown
+static long long heapInUse()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return (long long)mallinfo2().uordblks;
+#elif defined(__GLIBC__)
+    return (long long)(unsigned int)mallinfo().uordblks;
+#else
+    return -1;
+#endif
+}
+
+
+struct Snapshot
+{
+    Snapshot() :
+        allocations(g_allocations.load()),
+        liveBlocks(g_liveBlocks.load()),
+        newBytes(newBytesInUse()),
+        heapBytes(heapInUse())
+    {
+    }
+
+    long long allocations; // so far
+    long long liveBlocks;  // in use
+    long long newBytes;    // in use, -1 if not counted
+    long long heapBytes;   // in use, -1 if unknown
+};
+
+
+// every layout of the demo window rows, 'i' int and 'd' double elements:
+// MainWindow::buildRow* builds them on the ui widgets, keep them in sync
+struct Layout
+{
+    const char* name;
+    const char* prefix;
+    const char* elements;
+    const char* suffixes[3];
+};
+
+static const Layout layouts[] = {
+    { "empty (R1C1 R1C3 R1C4)",  "",        "",    { 0, 0, 0 } },
+    { "[ (R1C2)",                "[",       "",    { 0, 0, 0 } },
+    { "int (R2C1)",              "",        "i",   { "", 0, 0 } },
+    { "[int (R2C2)",             "[",       "i",   { "", 0, 0 } },
+    { "[int] (R2C3)",            "[",       "i",   { "]", 0, 0 } },
+    { "int] (R2C4)",             "",        "i",   { "]", 0, 0 } },
+    { "int int (R3C1)",          "",        "ii",  { " ", "", 0 } },
+    { "[int int (R3C2)",         "[",       "ii",  { " ", "", 0 } },
+    { "[int] int (R3C3 R4C1)",   "[",       "ii",  { "] ", "", 0 } },
+    { "int] int (R3C4)",         "",        "ii",  { "] ", "", 0 } },
+    { "[int] [int (R4C2)",       "[",       "ii",  { "] [", "", 0 } },
+    { "[int] [int] (R4C3)",      "[",       "ii",  { "] [", "]", 0 } },
+    { "[int] int] (R4C4)",       "[",       "ii",  { "] ", "]", 0 } },
+    { "3D position (R5)",        "X=",      "iii", { "  Y=", "  Z=", "" } },
+    { "attitudes (R6)",          "Yaw=",    "ddd", { "  Pitch=", "  Roll=", "" } },
+    { "increments (R7)",         "3D pos=", "id",  { "  Attitudes=", "", 0 } },
+};
+static const int layoutCount = sizeof(layouts) / sizeof(layouts[0]);
+
+
+// elements are owned by the widget, so that they are counted and freed with it
+static QtMultiSpinBox* build(const Layout& layout, QWidget* parent)
+{
+    QtMultiSpinBox* spin = new QtMultiSpinBox(parent);
+    spin->setPrefix(QLatin1String(layout.prefix));
+    for (int i=0; layout.elements[i]; i++) {
+        QtMultiSpinBoxElement* element = 0;
+        if (layout.elements[i] == 'd')
+            element = new QtDoubleMultiSpinBoxElement(spin);
+        else
+            element = new QtIntMultiSpinBoxElement(spin);
+        spin->appendSpinElement(element, QLatin1String(layout.suffixes[i]));
+    }
+    spin->show();
+    return spin;
+}
+
+
+struct Footprint
+{
+    double allocations; // per widget, freed ones included
+    double liveBlocks;  // per widget
+    double newBytes;    // per widget, -1 if not counted
+    double heapBytes;   // per widget, -1 if unknown
+
+    double bytes() const { return (heapBytes >= 0) ? heapBytes : newBytes; }
+};
+
+static Footprint measure(const Layout& layout, QWidget* parent, int widgets)
+{
+    // first widget: style, fonts and other caches of Qt
+    delete build(layout, parent);
+    QCoreApplication::processEvents();
+
+    QList<QtMultiSpinBox*> spins;
+    spins.reserve(widgets);
+    const Snapshot before;
+    for (int i=0; i < widgets; i++)
+        spins.append(build(layout, parent));
+    QCoreApplication::processEvents(); // polish
+    const Snapshot after;
+
+    qDeleteAll(spins);
+    QCoreApplication::processEvents();
+
+    Footprint footprint;
+    footprint.allocations = double(after.allocations - before.allocations) / widgets;
+    footprint.liveBlocks = double(after.liveBlocks - before.liveBlocks) / widgets;
+    footprint.newBytes = (before.newBytes >= 0)
+            ? double(after.newBytes - before.newBytes) / widgets : -1.0;
+    footprint.heapBytes = (before.heapBytes >= 0)
+            ? double(after.heapBytes - before.heapBytes) / widgets : -1.0;
+    return footprint;
+}
+
+
+int main(int argc, char *argv[])
+{
+    if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication a(argc, argv);
+
+    // budgets in bytes and allocations, 0: not checked
+    const QStringList args = a.arguments();
+    const int widgets = qMax(1, (args.count() > 1) ? args.at(1).toInt() : 200);
+    const double widgetBudget = (args.count() > 2) ? args.at(2).toDouble() : 0.0;
+    const double sectionBudget = (args.count() > 3) ? args.at(3).toDouble() : 0.0;
+    const double allocationBudget = (args.count() > 4) ? args.at(4).toDouble() : 0.0;
+
+    QWidget window;
+    window.show();
+
+    QTextStream out(stdout);
+    out << widgets << " widgets per layout, "
+        << ((heapInUse() >= 0) ? "heap bytes in use" : "bytes allocated by new")
+        << ", " << allocator << " calls" << '\n';
+
+    double baseline = 0.0;
+    double worstWidget = 0.0;
+    double worstSection = 0.0;
+    double worstAllocations = 0.0;
+    for (int i=0; i < layoutCount; i++) {
+        const Layout& layout = layouts[i];
+        const int sections = (int)qstrlen(layout.elements);
+        const Footprint footprint = measure(layout, &window, widgets);
+        if (i == 0)
+            baseline = footprint.bytes();
+        worstWidget = qMax(worstWidget, footprint.bytes());
+        worstAllocations = qMax(worstAllocations, footprint.allocations);
+
+        out << layout.name << ": " << qRound64(footprint.bytes()) << " B/widget, "
+            << qRound64(footprint.allocations) << " allocations/widget ("
+            << qRound64(footprint.liveBlocks) << " kept)";
+        if (sections > 0) {
+            // above the empty widget
+            const double perSection = (footprint.bytes() - baseline) / sections;
+            worstSection = qMax(worstSection, perSection);
+            out << ", " << qRound64(perSection) << " B/section";
+        }
+        out << '\n';
+    }
+
+    bool overBudget = false;
+    if (widgetBudget > 0 && worstWidget > widgetBudget) {
+        out << "over budget: " << qRound64(worstWidget) << " B/widget > " << qRound64(widgetBudget) << '\n';
+        overBudget = true;
+    }
+    if (sectionBudget > 0 && worstSection > sectionBudget) {
+        out << "over budget: " << qRound64(worstSection) << " B/section > " << qRound64(sectionBudget) << '\n';
+        overBudget = true;
+    }
+    if (allocationBudget > 0 && worstAllocations > allocationBudget) {
+        out << "over budget: " << qRound64(worstAllocations) << " allocations/widget > "
+            << qRound64(allocationBudget) << '\n';
+        overBudget = true;
+    }
+    out.flush();
+    return overBudget ? 1 : 0;
+}
@@ -0,0 +1,23 @@
+#-------------------------------------------------
+#
+# Memory footprint of QtMultiSpinBox on the demo layouts
+#
+#   qmake membench.pro && make
+#   ./multispinbox_membench [widgets] [max bytes per widget] [max bytes per section] [max allocations per widget]
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET = multispinbox_membench
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+!include(../multispinbox.pri) {
+    error("Missing multispinbox.pri")
+}
+
+SOURCES += main.cpp
@@ -0,0 +1,22 @@
+#-------------------------------------------------
+#
+# Differential fuzzing of the QtMultiSpinBox section parser
+#
+#   qmake fuzz.pro && make && ./multispinbox_fuzz [layouts] [seed]
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET = multispinbox_fuzz
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+!include(../multispinbox.pri) {
+    error("Missing multispinbox.pri")
+}
+
+SOURCES += main.cpp
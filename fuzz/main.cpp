@@ -0,0 +1,365 @@
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QIntValidator>
+#include <QLineEdit>
+#include <QStringList>
+#include <QTextStream>
+
+#include <climits>
+#include <random>
+
+#include <QtMultiSpinBox>
+#include <QtMultiSpinBoxElements>
+
+
+// Random layouts (prefix, suffixes with spaces, empty last suffix... like the
+// demo rows) and random inputs: checkAndSplit, textIndex, the incremental
+// splitSections and validate (exact state, also after range changes) are
+// compared with a naive reference parser.
+
+typedef std::mt19937 Random;
+
+static int uniform(Random& random, int min, int max)
+{
+    return std::uniform_int_distribution<int>(min, max)(random);
+}
+
+static QString pick(Random& random, const QStringList& list)
+{
+    return list.at(uniform(random, 0, list.count()-1));
+}
+
+static QString quoted(const QString& s)
+{
+    return QLatin1Char('"') + s + QLatin1Char('"');
+}
+
+
+// leftmost occurrence of each suffix, no backtracking (the documented behaviour)
+static bool referenceSplit(const QString& prefix, const QStringList& suffixes, const QString& text,
+                           QList<int>& starts, QList<int>& lengths)
+{
+    starts.clear();
+    lengths.clear();
+    if (!text.startsWith(prefix))
+        return false;
+    int pos = prefix.length();
+    for (int i=0; i < suffixes.count(); i++) {
+        starts.append(pos);
+        if (suffixes.at(i).isEmpty()) {
+            if (i+1 != suffixes.count())
+                return false;
+            lengths.append(text.length() - pos);
+            pos = text.length();
+        }
+        else {
+            int index = text.indexOf(suffixes.at(i), pos);
+            if (index < 0)
+                return false;
+            lengths.append(index - pos);
+            pos = index + suffixes.at(i).length();
+        }
+    }
+    return pos == text.length();
+}
+
+// every section validated from scratch with the current range of its element
+static QValidator::State referenceState(const QtMultiSpinBox& spin, const QString& text,
+                                        const QList<int>& starts, const QList<int>& lengths)
+{
+    QValidator::State result = QValidator::Acceptable;
+    for (int i=0; i < starts.count(); i++) {
+        const QtIntMultiSpinBoxElement* element =
+                static_cast<QtIntMultiSpinBoxElement*>(const_cast<QtMultiSpinBox&>(spin).getSpinElement(i));
+        QIntValidator validator(element->bottom(), element->top());
+        QString section = text.mid(starts.at(i), lengths.at(i));
+        int pos = 0;
+        QValidator::State state = validator.validate(section, pos);
+        if (state == QValidator::Invalid)
+            return QValidator::Invalid;
+        if (state == QValidator::Intermediate)
+            result = QValidator::Intermediate;
+    }
+    return result;
+}
+
+static QString stateName(QValidator::State state)
+{
+    switch (state) {
+    case QValidator::Invalid: return QLatin1String("Invalid");
+    case QValidator::Intermediate: return QLatin1String("Intermediate");
+    default: return QLatin1String("Acceptable");
+    }
+}
+
+
+class Fuzzer
+{
+public:
+    explicit Fuzzer(unsigned seed) : random(seed), mismatches(0), checks(0) {}
+
+    void run(int layouts, int inputsPerLayout);
+    void benchmark();
+
+    Random random;
+    int mismatches;
+    qint64 checks;
+
+private:
+    void buildLayout(QtMultiSpinBox& spin);
+    QString mutate(const QString& text, const QStringList& suffixes);
+    void reconfigure(QtMultiSpinBox& spin);
+    void report(const QtMultiSpinBox& spin, const QString& text, const QString& what);
+};
+
+static const QStringList prefixes = QStringList()
+        << QString() << QLatin1String("[") << QLatin1String("X=") << QLatin1String("3D pos=");
+static const QStringList suffixChoices = QStringList()
+        << QLatin1String(" ") << QLatin1String("] ") << QLatin1String("] [") << QLatin1String("]")
+        << QLatin1String("  Y=") << QLatin1String(",") << QLatin1String(":") << QLatin1String(".")
+        << QLatin1String(" ] ");
+static const QStringList pieces = QStringList()
+        << QLatin1String("0") << QLatin1String("7") << QLatin1String("-") << QLatin1String("12")
+        << QLatin1String(" ") << QLatin1String("]") << QLatin1String("[") << QLatin1String("Y")
+        << QLatin1String("=") << QLatin1String(",") << QLatin1String("a");
+
+
+void Fuzzer::buildLayout(QtMultiSpinBox& spin)
+{
+    const int count = uniform(random, 1, 6);
+    const bool prefixFirst = uniform(random, 0, 1);
+    const QString prefix = pick(random, prefixes);
+    if (prefixFirst)
+        spin.setPrefix(prefix);
+    for (int i=0; i < count; i++) {
+        // the last suffix may be empty
+        bool last = (i+1 == count);
+        QString suffix = (last && uniform(random, 0, 1)) ? QString() : pick(random, suffixChoices);
+        spin.appendSpinElement(new QtIntMultiSpinBoxElement, suffix);
+    }
+    if (!prefixFirst)
+        spin.setPrefix(prefix);
+}
+
+QString Fuzzer::mutate(const QString& text, const QStringList& suffixes)
+{
+    QString s = text;
+    const int pos = uniform(random, 0, s.length());
+    switch (uniform(random, 0, 4)) {
+    case 0: // typing
+        s.insert(pos, pick(random, pieces));
+        break;
+    case 1: // backspace
+        if (pos > 0)
+            s.remove(pos-1, 1);
+        break;
+    case 2: // selection replaced
+        s.replace(pos, uniform(random, 0, s.length() - pos), pick(random, pieces));
+        break;
+    case 3: // a suffix pasted
+        if (!suffixes.isEmpty())
+            s.insert(pos, suffixes.at(uniform(random, 0, suffixes.count()-1)));
+        break;
+    default: // anything
+        s.clear();
+        for (int i = uniform(random, 0, 12); i > 0; i--)
+            s += pick(random, pieces);
+        break;
+    }
+    return s;
+}
+
+// range changed after the text was validated (QValidator::changed)
+void Fuzzer::reconfigure(QtMultiSpinBox& spin)
+{
+    static const int bottoms[] = { INT_MIN, -100, -5, 0, 3 };
+    static const int tops[] = { INT_MAX, 100, 12, 7, 0 };
+    QtIntMultiSpinBoxElement* element =
+            static_cast<QtIntMultiSpinBoxElement*>(spin.getSpinElement(uniform(random, 0, spin.count()-1)));
+    const int bottom = bottoms[uniform(random, 0, 4)];
+    const int top = tops[uniform(random, 0, 4)];
+    element->setRange(qMin(bottom, top), qMax(bottom, top));
+}
+
+void Fuzzer::report(const QtMultiSpinBox& spin, const QString& text, const QString& what)
+{
+    mismatches++;
+    if (mismatches > 20)
+        return;
+    QStringList suffixes;
+    for (int i=0; i < spin.count(); i++)
+        suffixes << quoted(spin.suffix(i));
+    QTextStream(stdout) << "MISMATCH " << what << ": prefix=" << quoted(spin.prefix())
+                        << " suffixes=" << suffixes.join(QLatin1String(","))
+                        << " text=" << quoted(text) << '\n';
+}
+
+void Fuzzer::run(int layouts, int inputsPerLayout)
+{
+    for (int l=0; l < layouts; l++) {
+        QtMultiSpinBox spin;
+        buildLayout(spin);
+        QLineEdit* edit = spin.findChild<QLineEdit*>();
+        QtMultiSpinBoxPrivate* d = static_cast<QtMultiSpinBoxPrivate*>(const_cast<QValidator*>(edit->validator()));
+
+        const QString prefix = spin.prefix();
+        QStringList suffixes;
+        for (int i=0; i < spin.count(); i++)
+            suffixes << spin.suffix(i);
+
+        QString current = spin.text(); // built on first access
+        d->syncLayout();
+        QList<int> starts, lengths;
+        if (!referenceSplit(prefix, suffixes, current, starts, lengths))
+            report(spin, current, QLatin1String("initial text"));
+
+        for (int i=0; i < inputsPerLayout; i++) {
+            // element reconfigured: the same text is checked again
+            const bool reconfigured = (uniform(random, 0, 9) == 0);
+            if (reconfigured)
+                reconfigure(spin);
+            const QString candidate = reconfigured ? current : mutate(current, suffixes);
+            const bool refOk = referenceSplit(prefix, suffixes, candidate, starts, lengths);
+            checks++;
+
+            // full split
+            QList<QStringRef> splits;
+            bool ok = d->engine.checkAndSplit(candidate, splits);
+            if (ok != refOk)
+                report(spin, candidate, QLatin1String("checkAndSplit result"));
+            else if (ok) {
+                for (int k=0; k < splits.count(); k++) {
+                    if (splits.at(k).position() != starts.at(k) || splits.at(k).length() != lengths.at(k)) {
+                        report(spin, candidate, QString(QLatin1String("checkAndSplit section %1")).arg(k));
+                        break;
+                    }
+                }
+            }
+
+            // section offsets
+            if (refOk) {
+                for (int k=0; k <= spin.count(); k++) {
+                    int expected = (k < spin.count()) ? starts.at(k) : candidate.length();
+                    if (d->engine.textIndex(candidate, k) != expected) {
+                        report(spin, candidate, QString(QLatin1String("textIndex %1")).arg(k));
+                        break;
+                    }
+                }
+            }
+
+            // incremental split against the cached layout of the previous text
+            int first = 0;
+            QVector<int> newLengths;
+            bool incOk = d->splitSections(candidate, first, newLengths);
+            if (incOk != refOk)
+                report(spin, candidate, QLatin1String("splitSections result"));
+
+            // validation (QIntValidator sections), adopts the layout when not rejected,
+            // same state as a validation of every section from scratch
+            QString validated = candidate;
+            int pos = 0;
+            const QValidator::State state = d->validate(validated, pos);
+            const QValidator::State refState = refOk ? referenceState(spin, candidate, starts, lengths)
+                                                     : QValidator::Invalid;
+            const bool valid = (state != QValidator::Invalid);
+            if (state != refState)
+                report(spin, candidate, QString(QLatin1String("validate %1, expected %2"))
+                       .arg(stateName(state), stateName(refState)));
+            else if (valid) {
+                for (int k=0; k < spin.count(); k++) {
+                    if (d->sectionStart(k) != starts.at(k) || d->sectionLength(k) != lengths.at(k)) {
+                        report(spin, candidate, QString(QLatin1String("layout section %1")).arg(k));
+                        break;
+                    }
+                }
+                for (int p=0; p <= candidate.length(); p++) {
+                    int expected = -1;
+                    for (int k=0; k < spin.count() && expected < 0; k++) {
+                        if (starts.at(k) <= p && p <= starts.at(k) + lengths.at(k))
+                            expected = k;
+                    }
+                    if (d->sectionIndexAt(p) != expected) {
+                        report(spin, candidate, QString(QLatin1String("sectionIndexAt %1")).arg(p));
+                        break;
+                    }
+                }
+            }
+
+            // accepted like the line edit would
+            if (valid)
+                current = validated;
+        }
+    }
+}
+
+void Fuzzer::benchmark()
+{
+    QTextStream out(stdout);
+    const int sectionCounts[] = { 3, 64, 512 };
+    for (unsigned c=0; c < sizeof(sectionCounts)/sizeof(sectionCounts[0]); c++) {
+        QtMultiSpinBox spin;
+        spin.setPrefix(QLatin1String("["));
+        for (int i=0; i < sectionCounts[c]; i++)
+            spin.appendSpinElement(new QtIntMultiSpinBoxElement,
+                                   (i+1 < sectionCounts[c]) ? QLatin1String("] [") : QLatin1String("]"));
+        QLineEdit* edit = spin.findChild<QLineEdit*>();
+        QtMultiSpinBoxPrivate* d = static_cast<QtMultiSpinBoxPrivate*>(const_cast<QValidator*>(edit->validator()));
+        const QString text = spin.text();
+
+        // full split of the whole text
+        QElapsedTimer timer;
+        int iterations = 0;
+        timer.start();
+        do {
+            for (int i=0; i < 100; i++, iterations++) {
+                QList<QStringRef> splits;
+                d->engine.checkAndSplit(text, splits);
+            }
+        } while (timer.elapsed() < 300);
+        double fullRate = iterations * 1000.0 / qMax<qint64>(1, timer.elapsed());
+
+        // one keystroke in the middle section, split against the cached layout
+        d->syncLayout();
+        const int middle = d->sectionStart(sectionCounts[c] / 2);
+        QString typed = text;
+        typed.insert(middle, QLatin1Char('1'));
+        iterations = 0;
+        timer.restart();
+        do {
+            for (int i=0; i < 100; i++, iterations++) {
+                int first = 0;
+                QVector<int> lengths;
+                d->splitSections((i % 2) ? text : typed, first, lengths);
+            }
+        } while (timer.elapsed() < 300);
+        double incrementalRate = iterations * 1000.0 / qMax<qint64>(1, timer.elapsed());
+
+        out << sectionCounts[c] << " sections: checkAndSplit " << qRound64(fullRate)
+            << " splits/s, incremental splitSections " << qRound64(incrementalRate) << " splits/s\n";
+        out.flush();
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication a(argc, argv);
+
+    const QStringList args = a.arguments();
+    const int layouts = (args.count() > 1) ? args.at(1).toInt() : 2000;
+    const unsigned seed = (args.count() > 2) ? args.at(2).toUInt() : 1;
+
+    Fuzzer fuzzer(seed);
+    QElapsedTimer timer;
+    timer.start();
+    fuzzer.run(layouts, 200);
+    QTextStream out(stdout);
+    out << fuzzer.checks << " inputs on " << layouts << " layouts (seed " << seed << ") in "
+        << timer.elapsed() << " ms, " << fuzzer.mismatches << " mismatches\n";
+    out.flush();
+
+    fuzzer.benchmark();
+    return (fuzzer.mismatches == 0) ? 0 : 1;
+}
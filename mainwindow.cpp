@@ -4,13 +4,20 @@
 #include <QDebug>
 
 #include "QtMultiSpinBoxElements"
+#include "QtMultiSpinBoxGroup"
 
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
-    ui(new Ui::MainWindow)
+    ui(new Ui::MainWindow),
+    group(new QtMultiSpinBoxGroup(this)),
+    positionGroup(new QtMultiSpinBoxGroup(this)),
+    attitudeGroup(new QtMultiSpinBoxGroup(this))
 {
     ui->setupUi(this);
+    group->addSpinBoxes(this);
+    positionGroup->addSpinBox(ui->multispinPos3D);
+    attitudeGroup->addSpinBox(ui->multispinAttitudes);
 
     ui->comboHTextAlign->addItem(QLatin1String("Qt::AlignLeft"),     (int)Qt::AlignLeft);
     ui->comboHTextAlign->addItem(QLatin1String("Qt::AlignLeading"),  (int)Qt::AlignLeading);
@@ -56,29 +63,26 @@ void MainWindow::on_actionQuit_triggered()
     qApp->quit();
 }
 
-QList<QtMultiSpinBox *> MainWindow::allMultiSpinBox() const
-{
-    return findChildren<QtMultiSpinBox*>(QRegExp(".*"));
-}
-
 void MainWindow::firstUpdateForAll()
 {
     QSizePolicy sp(QSizePolicy::Preferred, QSizePolicy::Maximum);
-    foreach(QtMultiSpinBox* m, allMultiSpinBox()) {
+    group->apply([sp](QtMultiSpinBox* m) {
         m->setSizePolicy(sp);
-    }
+        m->setCurrentSectionHighlighted(true);
+    });
 }
 
 void MainWindow::updateAllWithOptions() const
 {
-    foreach(QtMultiSpinBox* m, allMultiSpinBox()) {
-        m->setEnabled(ui->checkEnable->isChecked());
-        m->setAlignment((Qt::Alignment)ui->comboHTextAlign->currentData().toInt()
-                        | (Qt::Alignment)ui->comboVTextAlign->currentData().toInt());
-        m->setCurrentSectionIndex(ui->spinCurrentSection->value());
-    }
+    const Qt::Alignment alignment = (Qt::Alignment)ui->comboHTextAlign->currentData().toInt()
+                                    | (Qt::Alignment)ui->comboVTextAlign->currentData().toInt();
+    group->setEnabled(ui->checkEnable->isChecked());
+    group->setAlignment(alignment);
+    group->setCurrentSectionIndex(ui->spinCurrentSection->value());
 }
 
+// each layout of the rows is also in the memory benchmark (bench/main.cpp
+// layouts): keep them in sync
 void MainWindow::buildRow1() const
 {
     ui->qmspbR1C2->setPrefix(QLatin1String("["));
@@ -181,12 +185,6 @@ void MainWindow::on_multispinAttitudes_editingFinished()
 
 void MainWindow::on_multispinIncr_editingFinished()
 {
-    for (int i=0; i < ui->multispinPos3D->count(); i++) {
-         QtIntMultiSpinBoxElement* e = static_cast<QtIntMultiSpinBoxElement*>(ui->multispinPos3D->getSpinElement(i));
-         e->setStepIncrement(ui->multispinIncr->value(0).toInt());
-    }
-    for (int i=0; i < ui->multispinAttitudes->count(); i++) {
-         QtDoubleMultiSpinBoxElement* e = static_cast<QtDoubleMultiSpinBoxElement*>(ui->multispinAttitudes->getSpinElement(i));
-         e->setStepIncrement(ui->multispinIncr->value(1).toDouble());
-    }
+    positionGroup->setStepIncrement(ui->multispinIncr->value(0));
+    attitudeGroup->setStepIncrement(ui->multispinIncr->value(1));
 }
@@ -3,7 +3,7 @@
 
 #include <QMainWindow>
 
-class QtMultiSpinBox;
+class QtMultiSpinBoxGroup;
 
 namespace Ui {
 class MainWindow;
@@ -17,8 +17,6 @@ public:
     explicit MainWindow(QWidget *parent = 0);
     ~MainWindow();
 
-    QList<QtMultiSpinBox*> allMultiSpinBox() const;
-
 public slots:
      void updateAllWithOptions() const;
 
@@ -41,6 +39,9 @@ private:
 
 private:
     Ui::MainWindow *ui;
+    QtMultiSpinBoxGroup *group;
+    QtMultiSpinBoxGroup *positionGroup; // step increments
+    QtMultiSpinBoxGroup *attitudeGroup;
 };
 
 #endif // MAINWINDOW_H
@@ -1,11 +1,22 @@
 INCLUDEPATH += $$PWD
 
+include($$PWD/multispinboxengine.pri)
+
 SOURCES += \
-    qtmultispinbox.cpp \
-    qtmultispinboxelements.cpp
+    $$PWD/qtmultispinbox.cpp \
+    $$PWD/qtmultispinboxconstraints.cpp \
+    $$PWD/qtmultispinboxgroup.cpp \
+    $$PWD/qtmultispinboxlayouts.cpp \
+    $$PWD/qtmultispinboxlight.cpp
 
 HEADERS  += \
-    qtmultispinbox.h \
-    qtmultispinboxelements.h \
-    QtMultiSpinBox \
-    QtMultiSpinBoxElements
+    $$PWD/qtmultispinbox.h \
+    $$PWD/qtmultispinboxconstraints.h \
+    $$PWD/qtmultispinboxgroup.h \
+    $$PWD/qtmultispinboxlayouts.h \
+    $$PWD/qtmultispinboxlight.h \
+    $$PWD/QtMultiSpinBox \
+    $$PWD/QtMultiSpinBoxConstraints \
+    $$PWD/QtMultiSpinBoxGroup \
+    $$PWD/QtMultiSpinBoxLayouts \
+    $$PWD/QtMultiSpinBoxLight
@@ -25,4 +25,5 @@ FORMS += \
     mainwindow.ui
 
 OTHER_FILES += \
-    multispinbox.pri
+    multispinbox.pri \
+    multispinboxengine.pri
@@ -0,0 +1,25 @@
+# widget-free part (QtCore and QtGui only): engine, elements, batch, journal, trace
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/qtmultispinboxbatch.cpp \
+    $$PWD/qtmultispinboxelements.cpp \
+    $$PWD/qtmultispinboxengine.cpp \
+    $$PWD/qtmultispinboxjournal.cpp \
+    $$PWD/qtmultispinboxtrace.cpp
+
+HEADERS  += \
+    $$PWD/qtmultispinboxbatch.h \
+    $$PWD/qtmultispinboxelements.h \
+    $$PWD/qtmultispinboxengine.h \
+    $$PWD/qtmultispinboxjournal.h \
+    $$PWD/qtmultispinboxtrace.h \
+    $$PWD/QtMultiSpinBoxBatch \
+    $$PWD/QtMultiSpinBoxElements \
+    $$PWD/QtMultiSpinBoxEngine \
+    $$PWD/QtMultiSpinBoxJournal
+
+# timing spans of the hot paths, dumped with QtMultiSpinBoxTrace::toJson()
+multispinbox_trace {
+    DEFINES += QTMULTISPINBOX_TRACE
+}
@@ -1,9 +1,30 @@
 #include "qtmultispinbox.h"
 
+#include <QApplication>
+#include <QClipboard>
+#include <QContextMenuEvent>
+#include <QDateTime>
+#include <QDropEvent>
+#include <QElapsedTimer>
+#include <QFontMetrics>
+#include <QHash>
+#include <QKeyEvent>
 #include <QLineEdit>
+#include <QMenu>
+#include <QMimeData>
+#include <QMouseEvent>
+#include <QMutex>
+#include <QPainter>
+#include <QPointer>
+#include <QResizeEvent>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QWaitCondition>
 #include <QDebug>
 
+#include "qtmultispinboxconstraints.h"
 #include "qtmultispinboxelements.h"
+#include "qtmultispinboxtrace.h"
 
 
 #define DBG_LEVEL_VALIDATE      1
@@ -20,20 +41,191 @@
 
 QT_BEGIN_NAMESPACE
 
-template <typename T>
-bool qIsBetweenEqual(T min, T max, T value)
+// record the duration of the current scope in a latency histogram (one
+// QElapsedTimer: always on, unlike the trace)
+class QtMultiSpinBoxLatencyScope
 {
-    return (min == value || min < value)
-            && (value == max || value < max);
+public:
+    explicit QtMultiSpinBoxLatencyScope(QAtomicInt* histogram) :
+        m_histogram(histogram)
+    {
+        m_timer.start();
+    }
+
+    ~QtMultiSpinBoxLatencyScope()
+    {
+        QtMultiSpinBoxCounters::addLatency(m_histogram, m_timer.nsecsElapsed());
+    }
+
+private:
+    QAtomicInt* m_histogram;
+    QElapsedTimer m_timer;
+};
+
+#define QMSBLATENCY(HISTOGRAM) QtMultiSpinBoxLatencyScope qmsbLatencyScope(HISTOGRAM)
+
+
+// underlines of the sections checked asynchronously: dotted while
+// pending, red wave when rejected
+class QtMultiSpinBoxStatusMarks : public QWidget
+{
+public:
+    explicit QtMultiSpinBoxStatusMarks(QWidget* parent) :
+        QWidget(parent)
+    {
+        setAttribute(Qt::WA_TransparentForMouseEvents);
+        setFocusPolicy(Qt::NoFocus);
+        show();
+    }
+
+    void setMarks(const QVector<QRect>& pending, const QVector<QRect>& rejected)
+    {
+        if (pending == m_pending && rejected == m_rejected)
+            return;
+        // old and new marks only
+        QRegion dirty;
+        foreach (const QRect& rect, m_pending + m_rejected + pending + rejected)
+            dirty += rect;
+        m_pending = pending;
+        m_rejected = rejected;
+        update(dirty);
+    }
+
+protected:
+    void paintEvent(QPaintEvent*)
+    {
+        QPainter painter(this);
+        QPen pen(palette().color(QPalette::Disabled, QPalette::Text));
+        pen.setStyle(Qt::DotLine);
+        painter.setPen(pen);
+        foreach (const QRect& rect, m_pending)
+            painter.drawLine(rect.left(), rect.bottom() - 1, rect.right(), rect.bottom() - 1);
+        painter.setPen(QPen(Qt::red));
+        foreach (const QRect& rect, m_rejected) {
+            QPolygon wave;
+            for (int x = rect.left(); x <= rect.right(); x += 2)
+                wave << QPoint(x, rect.bottom() - 1 - (((x - rect.left()) / 2) % 2) * 2);
+            painter.drawPolyline(wave);
+        }
+    }
+
+private:
+    QVector<QRect> m_pending;
+    QVector<QRect> m_rejected;
+};
+
+
+// tint over the current section: moving it repaints its old and new
+// rectangles only, the line edit text is not laid out again
+class QtMultiSpinBoxHighlight : public QWidget
+{
+public:
+    explicit QtMultiSpinBoxHighlight(QWidget* parent) :
+        QWidget(parent)
+    {
+        setAttribute(Qt::WA_TransparentForMouseEvents);
+        setFocusPolicy(Qt::NoFocus);
+        hide();
+    }
+
+protected:
+    void paintEvent(QPaintEvent*)
+    {
+        QColor color = palette().color(QPalette::Highlight);
+        color.setAlpha(48);
+        QPainter painter(this);
+        painter.fillRect(rect(), color);
+    }
+};
+
+
+
+QtMultiSpinBoxStatistics::QtMultiSpinBoxStatistics()
+{
+    for (int i=0; i < CounterCount; i++)
+        counters[i] = 0;
+    for (int i=0; i < LatencyBuckets; i++) {
+        validateLatency[i] = 0;
+        stepLatency[i] = 0;
+    }
 }
 
 
+void QtMultiSpinBoxCounters::addLatency(QAtomicInt* histogram, qint64 ns)
+{
+    int bucket = 0;
+    while (bucket+1 < QtMultiSpinBoxStatistics::LatencyBuckets && (ns >> (bucket+1)) != 0)
+        bucket++;
+    histogram[bucket].fetchAndAddRelaxed(1);
+}
+
+QtMultiSpinBoxStatistics QtMultiSpinBoxCounters::snapshot() const
+{
+    QtMultiSpinBoxStatistics s;
+    for (int i=0; i < QtMultiSpinBoxStatistics::CounterCount; i++)
+        s.counters[i] = (uint)counters[i].loadAcquire();
+    for (int i=0; i < QtMultiSpinBoxStatistics::LatencyBuckets; i++) {
+        s.validateLatency[i] = (uint)validateLatency[i].loadAcquire();
+        s.stepLatency[i] = (uint)stepLatency[i].loadAcquire();
+    }
+    return s;
+}
+
+void QtMultiSpinBoxCounters::reset()
+{
+    for (int i=0; i < QtMultiSpinBoxStatistics::CounterCount; i++)
+        counters[i].storeRelease(0);
+    for (int i=0; i < QtMultiSpinBoxStatistics::LatencyBuckets; i++) {
+        validateLatency[i].storeRelease(0);
+        stepLatency[i].storeRelease(0);
+    }
+}
+
+//==============================================================================
+
 
-QtMultiSpinBoxData::QtMultiSpinBoxData(QtMultiSpinBoxElement* element,
-                                       const QString& suffix) :
-    element(element),
-    suffix(suffix)
+void QtMultiSpinBoxOffsets::reset(const QVector<int>& spans)
 {
+    const int n = spans.count();
+    m_tree.fill(0, n + 1);
+    for (int i=1; i <= n; i++) {
+        m_tree[i] += spans.at(i-1);
+        int parent = i + (i & -i);
+        if (parent <= n)
+            m_tree[parent] += m_tree.at(i);
+    }
+}
+
+void QtMultiSpinBoxOffsets::add(int index, int delta)
+{
+    const int n = size();
+    for (int i = index+1; i <= n; i += (i & -i))
+        m_tree[i] += delta;
+}
+
+int QtMultiSpinBoxOffsets::sum(int count) const
+{
+    int total = 0;
+    for (int i = count; i > 0; i -= (i & -i))
+        total += m_tree.at(i);
+    return total;
+}
+
+int QtMultiSpinBoxOffsets::countUpTo(int offset) const
+{
+    // spans are never negative: binary lifting over the tree
+    const int n = size();
+    int step = 1;
+    while (step * 2 <= n)
+        step *= 2;
+    int count = 0;
+    for (; step > 0; step /= 2) {
+        if (count + step <= n && m_tree.at(count + step) <= offset) {
+            count += step;
+            offset -= m_tree.at(count);
+        }
+    }
+    return count;
 }
 
 //==============================================================================
@@ -79,17 +271,15 @@ void QtMultiSpinBox::insertSpinElement(int index, QtMultiSpinBoxElement* element
     QMSBDEBUG(DBG_LEVEL_INSERT) << "insert at" << index << "(suffix:" << suffix << ")";
 
     Q_D(QtMultiSpinBox);
-    QString simplifiedSuffix = d->simplify(suffix);
+    QString simplifiedSuffix = QtMultiSpinBoxEngine::simplify(suffix);
     // if not the first element -> check the separation suffix
-    if (d->elementDatas.count() >= 1) {
+    if (d->engine.count() >= 1) {
         // if not the last -> check the given suffix
-        if (index != d->elementDatas.count())
+        if (index != d->engine.count())
             Q_ASSERT(!simplifiedSuffix.isEmpty());
         // if not the first -> check the previous element suffix
-        if (index != 0) {
-            QtMultiSpinBoxData* elementBeforeIndex = d->elementDatas.value(index-1);
-            Q_ASSERT(!elementBeforeIndex->suffix.isEmpty());
-        }
+        if (index != 0)
+            Q_ASSERT(!d->engine.suffix(index-1).isEmpty());
     }
 
     d->insert(index, element, simplifiedSuffix);
@@ -105,7 +295,7 @@ QtMultiSpinBoxElement* QtMultiSpinBox::takeSpinElement(int index)
     Q_ASSERT(index >= 0 && index < count());
 
     Q_D(QtMultiSpinBox);
-    QScopedPointer<QtMultiSpinBoxData> eData(d->take(index));
+    QtMultiSpinBoxElement* element = d->take(index);
 
     bool changeCSI = (d->currentSectionIndex == index);
     if (changeCSI) {
@@ -113,7 +303,7 @@ QtMultiSpinBoxElement* QtMultiSpinBox::takeSpinElement(int index)
         Q_EMIT currentSectionIndexChanged(d->currentSectionIndex);
     }
 
-    return eData.data()->element;
+    return element;
 }
 
 QtMultiSpinBoxElement* QtMultiSpinBox::getSpinElement(int index)
@@ -128,7 +318,7 @@ QtMultiSpinBoxElement* QtMultiSpinBox::getSpinElement(int index)
 int QtMultiSpinBox::count() const
 {
     Q_D(const QtMultiSpinBox);
-    return d->elementDatas.count();
+    return d->engine.count();
 }
 
 
@@ -144,36 +334,46 @@ int QtMultiSpinBox::currentSectionIndex() const
 void QtMultiSpinBox::setCurrentSectionIndex(int index)
 {
     Q_D(QtMultiSpinBox);
-    if (count() <= 0)
-        d->currentSectionIndex = -1;
-    else {
+    int newIndex = -1;
+    if (count() > 0) {
         if (index < 0 || index >= count())
-            d->currentSectionIndex = 0;
+            newIndex = 0;
         else
-            d->currentSectionIndex = index;
+            newIndex = index;
 
         // check cursor!
     }
+    if (newIndex == d->currentSectionIndex)
+        return;
+    d->currentSectionIndex = newIndex;
 
-    update();
-    Q_EMIT currentSectionIndexChanged(index);
+    // only the highlight depends on the current section
+    d->updateHighlight();
+    Q_EMIT currentSectionIndexChanged(newIndex);
 }
 
 QString QtMultiSpinBox::prefix() const
 {
     Q_D(const QtMultiSpinBox);
-    return d->prefix;
+    return d->engine.prefix();
 }
 
 void QtMultiSpinBox::setPrefix(const QString& prefix)
 {
     Q_D(QtMultiSpinBox);
-    QString oldPrefix = d->prefix;
-    d->prefix = prefix.simplified();
+    if (d->deferText()) {
+        d->engine.setPrefix(prefix);
+        d->invalidateLayout();
+        return;
+    }
+    const int oldLength = d->engine.prefix().length();
+    d->engine.setPrefix(prefix);
+    d->invalidateLayout();
 
     // replacing prefix
     QString text = lineEdit()->text();
-    text.replace(0, oldPrefix.length(), d->prefix);
+    text.replace(0, oldLength, d->engine.prefix());
+    d->counters.count(QtMultiSpinBoxStatistics::TextRewrites);
     lineEdit()->setText(text);
 }
 
@@ -181,7 +381,7 @@ QString QtMultiSpinBox::suffix(int index) const
 {
     Q_ASSERT(index >= 0 && index < count());
     Q_D(const QtMultiSpinBox);
-    return d->elementDatas.value(index)->suffix;
+    return d->engine.suffix(index);
 }
 
 void QtMultiSpinBox::setSuffix(int index, const QString& suffix)
@@ -189,18 +389,25 @@ void QtMultiSpinBox::setSuffix(int index, const QString& suffix)
     Q_ASSERT(index >= 0 && index < count());
 
     Q_D(QtMultiSpinBox);
-    QString& elementSuffix(d->elementDatas.value(index)->suffix);
-    QString newSuffix = d->simplify(suffix);
+    if (d->deferText()) {
+        d->engine.setSuffix(index, suffix);
+        d->invalidateLayout();
+        return;
+    }
 
+    const int oldLength = d->engine.suffix(index).length();
     QString text = lineEdit()->text();
-    int startIndexElement = d->textIndex(text, index+1) - elementSuffix.length();
+    int startIndexElement = (d->syncLayout() ? d->sectionStart(index+1) : d->engine.textIndex(text, index+1))
+            - oldLength;
     Q_ASSERT(startIndexElement >= 0);
 
-    // replacing text
-    text.replace(startIndexElement, elementSuffix.length(), newSuffix);
-
     // change
-    elementSuffix = newSuffix;
+    d->engine.setSuffix(index, suffix);
+    d->invalidateLayout();
+
+    // replacing text
+    text.replace(startIndexElement, oldLength, d->engine.suffix(index));
+    d->counters.count(QtMultiSpinBoxStatistics::TextRewrites);
     lineEdit()->setText(text);
 }
 
@@ -217,18 +424,76 @@ QAbstractSpinBox::StepEnabled QtMultiSpinBox::stepEnabled() const
 
 void QtMultiSpinBox::stepBy(int steps)
 {
+    QMSBTRACE("stepBy");
     Q_D(QtMultiSpinBox);
-    if (d->currentSectionIndex >= 0) {
+    QMSBLATENCY(d->counters.stepLatency);
+    d->counters.count(QtMultiSpinBoxStatistics::Steps);
+    if (d->currentSectionIndex >= 0 && d->syncLayout()) {
         QtMultiSpinBoxElement* e = d->get(d->currentSectionIndex)->element;
-        QString s = d->textAt(text(), d->currentSectionIndex);
+        QString s = d->sectionRef(d->currentSectionIndex).toString();
         QVariant v = e->valueFromText(s);
         v = e->stepBy(v, steps);
-        s = e->textFromValue(v);
-        d->changeText(lineEdit(), d->setTextAt(text(), d->currentSectionIndex, s));
+        s = e->memoTextFromValue(v);
+        d->changeText(lineEdit(), d->replacedSection(d->currentSectionIndex, s));
+        d->journalChanges(d->currentSectionIndex, d->currentSectionIndex, QtMultiSpinBoxChange::Edited);
+        d->propagateConstraints();
     }
 }
 
 
+QtMultiSpinBoxStatistics QtMultiSpinBox::statistics() const
+{
+    Q_D(const QtMultiSpinBox);
+    return d->counters.snapshot();
+}
+
+void QtMultiSpinBox::resetStatistics()
+{
+    Q_D(QtMultiSpinBox);
+    d->counters.reset();
+}
+
+
+void QtMultiSpinBox::addConstraint(QtMultiSpinBoxConstraint* constraint)
+{
+    Q_ASSERT(constraint != NULL);
+    Q_D(QtMultiSpinBox);
+    d->constraints.append(constraint);
+    d->sortConstraints();
+}
+
+void QtMultiSpinBox::clearConstraints()
+{
+    Q_D(QtMultiSpinBox);
+    qDeleteAll(d->constraints);
+    d->constraints.clear();
+    d->changedSections.clear();
+}
+
+QList<QtMultiSpinBoxConstraint*> QtMultiSpinBox::constraints() const
+{
+    Q_D(const QtMultiSpinBox);
+    return d->constraints;
+}
+
+
+void QtMultiSpinBox::setJournalCapacity(int capacity)
+{
+    Q_D(QtMultiSpinBox);
+    if (capacity <= 0)
+        d->journal.clear();
+    else if (!d->journal || d->journal->capacity() != capacity)
+        d->journal = QSharedPointer<QtMultiSpinBoxJournal>(new QtMultiSpinBoxJournal(capacity));
+    d->resetJournalValues();
+}
+
+QSharedPointer<QtMultiSpinBoxJournal> QtMultiSpinBox::journal() const
+{
+    Q_D(const QtMultiSpinBox);
+    return d->journal;
+}
+
+
 //------------------------------------------------------------------------------
 
 
@@ -239,6 +504,114 @@ void QtMultiSpinBox::focusInEvent(QFocusEvent* event)
     QAbstractSpinBox::focusInEvent(event);
 }
 
+void QtMultiSpinBox::showEvent(QShowEvent* event)
+{
+    // configured while hidden: single text build
+    Q_D(QtMultiSpinBox);
+    d->ensureText();
+    QAbstractSpinBox::showEvent(event);
+    d->updateHighlight();
+    d->updateSectionMarks();
+}
+
+void QtMultiSpinBox::resizeEvent(QResizeEvent* event)
+{
+    Q_D(QtMultiSpinBox);
+    QAbstractSpinBox::resizeEvent(event);
+    d->updateHighlight();
+    if (d->statusMarks)
+        d->updateSectionMarks();
+}
+
+void QtMultiSpinBox::changeEvent(QEvent* event)
+{
+    Q_D(QtMultiSpinBox);
+    QAbstractSpinBox::changeEvent(event);
+    if (event->type() == QEvent::FontChange || event->type() == QEvent::StyleChange) {
+        d->invalidateExtents();
+        d->updateHighlight();
+        if (d->statusMarks)
+            d->updateSectionMarks();
+    }
+}
+
+void QtMultiSpinBox::keyPressEvent(QKeyEvent* event)
+{
+    if (event->matches(QKeySequence::Paste)) {
+        paste();
+        event->accept();
+        return;
+    }
+    // partial selection: regular copy
+    if (event->matches(QKeySequence::Copy)
+            && (!lineEdit()->hasSelectedText() || lineEdit()->selectedText() == text())) {
+        copy();
+        event->accept();
+        return;
+    }
+    QAbstractSpinBox::keyPressEvent(event);
+}
+
+void QtMultiSpinBox::contextMenuEvent(QContextMenuEvent* event)
+{
+    // menu of QAbstractSpinBox, with Paste and Select All of the spin box
+    QPointer<QMenu> menu = lineEdit()->createStandardContextMenu();
+    if (!menu)
+        return;
+    const QList<QAction*> actions = menu->actions();
+    for (int i=0; i < actions.count(); i++) {
+        QAction* action = actions.at(i);
+        if (disconnect(action, SIGNAL(triggered()), lineEdit(), SLOT(paste())))
+            connect(action, SIGNAL(triggered()), this, SLOT(paste()));
+        else if (disconnect(action, SIGNAL(triggered()), lineEdit(), SLOT(selectAll())))
+            connect(action, SIGNAL(triggered()), this, SLOT(selectAll()));
+    }
+    menu->addSeparator();
+    const StepEnabled se = stepEnabled();
+    QAction* up = menu->addAction(QAbstractSpinBox::tr("&Step up"));
+    up->setEnabled(se & StepUpEnabled);
+    QAction* down = menu->addAction(QAbstractSpinBox::tr("Step &down"));
+    down->setEnabled(se & StepDownEnabled);
+
+    const QPointer<QtMultiSpinBox> that = this;
+    const QPoint pos = (event->reason() == QContextMenuEvent::Mouse)
+            ? event->globalPos() : mapToGlobal(QPoint(width() / 2, height() / 2));
+    const QAction* action = menu->exec(pos);
+    delete static_cast<QMenu*>(menu);
+    if (that && action == up)
+        stepBy(1);
+    else if (that && action == down)
+        stepBy(-1);
+    event->accept();
+}
+
+bool QtMultiSpinBox::eventFilter(QObject* watched, QEvent* event)
+{
+    // the other pastes of the line edit: compact text first, like paste()
+    if (watched == lineEdit() && !isReadOnly()) {
+        if (event->type() == QEvent::MouseButtonRelease
+                && static_cast<QMouseEvent*>(event)->button() == Qt::MiddleButton
+                && QApplication::clipboard()->supportsSelection()) {
+            if (setCompactText(QApplication::clipboard()->text(QClipboard::Selection))) {
+                lineEdit()->deselect();
+                return true;
+            }
+        }
+        else if (event->type() == QEvent::Drop) {
+            QDropEvent* drop = static_cast<QDropEvent*>(event);
+            // moves inside the line edit stay regular
+            if (drop->source() != lineEdit() && drop->mimeData()->hasText()
+                    && setCompactText(drop->mimeData()->text())) {
+                QDragLeaveEvent leave; // hides the drop cursor of the line edit
+                QCoreApplication::sendEvent(lineEdit(), &leave);
+                drop->acceptProposedAction();
+                return true;
+            }
+        }
+    }
+    return QAbstractSpinBox::eventFilter(watched, event);
+}
+
 
 //------------------------------------------------------------------------------
 
@@ -248,27 +621,83 @@ QVariant QtMultiSpinBox::value(int index) const
     Q_ASSERT(index >= 0 && index < count());
     Q_D(const QtMultiSpinBox);
     QtMultiSpinBoxElement* e = d->get(index)->element;
-    QString s = d->textAt(text(), index);
-    return e->valueFromText(s);
+    return e->valueFromText(textRef(index).toString());
 }
 
 QString QtMultiSpinBox::text(int index) const
+{
+    return textRef(index).toString();
+}
+
+QStringRef QtMultiSpinBox::textRef(int index) const
 {
     Q_ASSERT(index >= 0 && index < count());
     Q_D(const QtMultiSpinBox);
-    return d->textAt(text(), index);
+    if (!d->syncLayout())
+        return QStringRef();
+    return d->sectionRef(index);
+}
+
+QRect QtMultiSpinBox::sectionRect(int index) const
+{
+    Q_ASSERT(index >= 0 && index < count());
+    Q_D(const QtMultiSpinBox);
+    if (!d->syncLayout())
+        return QRect();
+    d->ensureExtents();
+    return d->sectionRect(index);
+}
+
+bool QtMultiSpinBox::isCurrentSectionHighlighted() const
+{
+    Q_D(const QtMultiSpinBox);
+    return d->highlight != 0;
+}
+
+void QtMultiSpinBox::setCurrentSectionHighlighted(bool highlighted)
+{
+    Q_D(QtMultiSpinBox);
+    if (highlighted == (d->highlight != 0))
+        return;
+    if (highlighted) {
+        d->highlight = new QtMultiSpinBoxHighlight(lineEdit());
+        d->updateHighlight();
+    }
+    else {
+        delete d->highlight;
+        d->highlight = 0;
+    }
+}
+
+QList<QStringRef> QtMultiSpinBox::textRefs() const
+{
+    Q_D(const QtMultiSpinBox);
+    QList<QStringRef> refs;
+    if (d->syncLayout()) {
+        refs.reserve(count());
+        int start = d->engine.prefix().length();
+        for (int i=0; i < count(); i++) {
+            refs.append(QStringRef(&d->currentText, start, d->sectionLength(i)));
+            start += d->sectionLength(i) + d->engine.suffix(i).length();
+        }
+    }
+    return refs;
 }
 
 void QtMultiSpinBox::setValue(int index, const QVariant& sectionValue)
 {
+    QMSBTRACE("setValue");
     Q_ASSERT(index >= 0 && index < count());
     Q_D(QtMultiSpinBox);
     QtMultiSpinBoxElement* element = d->get(index)->element;
-    QString textOfValue = element->textFromValue(sectionValue);
+    QString textOfValue = element->memoTextFromValue(sectionValue);
     int pos = 0;
     Q_ASSERT(element->validate(textOfValue, pos) != QValidator::Invalid);
-    QString s = d->setTextAt(text(), index, textOfValue);
-    d->changeText(lineEdit(), s);
+    Q_UNUSED(pos);
+    if (d->syncLayout())
+        d->changeText(lineEdit(), d->replacedSection(index, textOfValue));
+    d->journalChanges(index, index, QtMultiSpinBoxChange::Programmatic);
+    d->propagateConstraints();
 }
 
 void QtMultiSpinBox::setText(int index, const QString& sectionText)
@@ -279,14 +708,334 @@ void QtMultiSpinBox::setText(int index, const QString& sectionText)
     QString inputText = sectionText;
     int pos = 0;
     Q_ASSERT(element->validate(inputText, pos) != QValidator::Invalid);
-    QString s = d->setTextAt(text(), index, inputText);
-    d->changeText(lineEdit(), s);
+    Q_UNUSED(pos);
+    if (d->syncLayout())
+        d->changeText(lineEdit(), d->replacedSection(index, inputText));
+    d->journalChanges(index, index, QtMultiSpinBoxChange::Programmatic);
+    d->propagateConstraints();
 }
 
+QVariantList QtMultiSpinBox::values() const
+{
+    Q_D(const QtMultiSpinBox);
+    QVariantList result;
+    const QList<QStringRef> splits = textRefs();
+    result.reserve(splits.count());
+    for (int i=0; i < splits.count(); i++)
+        result.append(d->get(i)->element->valueFromText(splits.at(i).toString()));
+    return result;
+}
+
+QPointF QtMultiSpinBox::pointValue() const
+{
+    const QVariantList v = values();
+    return QPointF(v.value(0).toDouble(), v.value(1).toDouble());
+}
+
+QVector3D QtMultiSpinBox::vector3DValue() const
+{
+    const QVariantList v = values();
+    return QVector3D(v.value(0).toFloat(), v.value(1).toFloat(), v.value(2).toFloat());
+}
+
+void QtMultiSpinBox::setValues(const QVariantList& values)
+{
+    QMSBTRACE("setValues");
+    Q_D(QtMultiSpinBox);
+    if (!d->syncLayout())
+        return;
+
+    QMap<int, QString> texts;
+    for (int i=0; i < values.count() && i < count(); i++) {
+        if (!values.at(i).isValid())
+            continue;
+        QtMultiSpinBoxElement* element = d->get(i)->element;
+        QString textOfValue = element->memoTextFromValue(values.at(i));
+        int pos = 0;
+        if (textOfValue.isNull() || element->memoValidate(textOfValue, pos) == QValidator::Invalid) {
+            d->counters.count(QtMultiSpinBoxStatistics::RejectedInputs);
+            continue;
+        }
+        if (d->sectionRef(i) != textOfValue)
+            texts.insert(i, textOfValue);
+    }
+    // animation frames often leave the text unchanged
+    if (texts.isEmpty())
+        return;
+    d->changeText(lineEdit(), d->replacedSections(texts));
+    foreach (int index, texts.keys())
+        d->journalChanges(index, index, QtMultiSpinBoxChange::Programmatic);
+    d->propagateConstraints();
+}
+
+void QtMultiSpinBox::setPointValue(const QPointF& point)
+{
+    setValues(QVariantList() << point.x() << point.y());
+}
+
+void QtMultiSpinBox::setVector3DValue(const QVector3D& vector)
+{
+    setValues(QVariantList() << vector.x() << vector.y() << vector.z());
+}
+
+//------------------------------------------------------------------------------
+// clipboard
+
+
+QString QtMultiSpinBox::compactText(const QString& separator) const
+{
+    Q_D(const QtMultiSpinBox);
+    const QList<QStringRef> splits = textRefs();
+    if (splits.count() != count())
+        return QString();
+
+    QString result;
+    result.reserve(d->currentText.length());
+    for (int i=0; i < splits.count(); i++) {
+        if (i > 0)
+            result += separator;
+        result += splits.at(i);
+    }
+    return result;
+}
+
+bool QtMultiSpinBox::setCompactText(const QString& input)
+{
+    Q_D(QtMultiSpinBox);
+    if (isEmpty())
+        return false;
+
+    // already in the layout of this spin box
+    QString fullText = input;
+    int pos = 0;
+    if (d->validate(fullText, pos) != QValidator::Invalid) {
+        d->changeText(lineEdit(), fullText);
+        d->journalChanges(0, count() - 1, QtMultiSpinBoxChange::Edited);
+        d->propagateConstraints();
+        return true;
+    }
+
+    QList<QStringRef> tokens;
+    QtMultiSpinBoxEngine::tokenize(input, false, tokens);
+    if (tokens.count() < count())
+        QtMultiSpinBoxEngine::tokenize(input, true, tokens);
+    // a single value is left to the line edit (insertion at cursor)
+    if (tokens.isEmpty() || tokens.count() > count() || (tokens.count() == 1 && count() > 1))
+        return false;
+
+    int first = 0;
+    if (tokens.count() < count())
+        first = qMin(qMax(0, d->currentSectionIndex), count() - tokens.count());
+
+    QStringList texts;
+    texts.reserve(tokens.count());
+    for (int i=0; i < tokens.count(); i++) {
+        QString sectionText = tokens.at(i).toString();
+        int sectionPos = 0;
+        if (d->get(first + i)->element->validate(sectionText, sectionPos) == QValidator::Invalid) {
+            d->counters.count(QtMultiSpinBoxStatistics::RejectedInputs);
+            return false;
+        }
+        texts.append(sectionText);
+    }
+
+    d->changeText(lineEdit(), d->engine.setTextsAt(text(), first, texts));
+    d->journalChanges(first, first + texts.count() - 1, QtMultiSpinBoxChange::Edited);
+    d->propagateConstraints();
+    return true;
+}
+
+void QtMultiSpinBox::copy() const
+{
+    QApplication::clipboard()->setText(compactText());
+}
+
+void QtMultiSpinBox::paste()
+{
+    if (isReadOnly())
+        return;
+    if (!setCompactText(QApplication::clipboard()->text()))
+        lineEdit()->paste();
+}
+
+//==============================================================================
+// asynchronous validation
+
+
+class QtMultiSpinBoxAsyncEvent : public QEvent
+{
+public:
+    enum Kind { Result, RefreshMarks };
+
+    static QEvent::Type eventType()
+    {
+        static int type = QEvent::registerEventType();
+        return (QEvent::Type)type;
+    }
+
+    explicit QtMultiSpinBoxAsyncEvent(Kind kind) :
+        QEvent(eventType()),
+        kind(kind),
+        section(-1),
+        request(0),
+        state(QValidator::Acceptable)
+    {
+    }
+
+    Kind kind;
+    int section;
+    int request;
+    QValidator::State state;
+    QString text;
+};
+
+
+// lives in the GUI thread and is shared with the running checks:
+// results are posted to it, and dropped once the spin box is gone
+class QtMultiSpinBoxAsyncRelay : public QObject
+{
+public:
+    explicit QtMultiSpinBoxAsyncRelay(QtMultiSpinBoxPrivate* d) : d(d) {}
+
+    void setLatest(int section, int request)
+    {
+        QMutexLocker locker(&mutex);
+        latest.insert(section, request);
+    }
+
+    bool isLatest(int section, int request) const
+    {
+        QMutexLocker locker(&mutex);
+        return latest.value(section, -1) == request;
+    }
+
+    void finish(int section, int request)
+    {
+        QMutexLocker locker(&mutex);
+        if (latest.value(section, -1) == request)
+            latest.remove(section);
+    }
+
+    void clearRequests()
+    {
+        QMutexLocker locker(&mutex);
+        latest.clear();
+    }
+
+    // elements in use by the checks: retire() drops the queued checks of an
+    // element and waits for the running ones, then it can be deleted
+    void enlist(const QtMultiSpinBoxElement* element)
+    {
+        QMutexLocker locker(&mutex);
+        live.insert(element);
+    }
+
+    bool acquire(const QtMultiSpinBoxElement* element)
+    {
+        QMutexLocker locker(&mutex);
+        if (!live.contains(element))
+            return false;
+        running[element]++;
+        return true;
+    }
+
+    void release(const QtMultiSpinBoxElement* element)
+    {
+        QMutexLocker locker(&mutex);
+        if (--running[element] == 0) {
+            running.remove(element);
+            released.wakeAll();
+        }
+    }
+
+    void retire(const QtMultiSpinBoxElement* element)
+    {
+        QMutexLocker locker(&mutex);
+        live.remove(element);
+        while (running.contains(element))
+            released.wait(&mutex);
+    }
+
+    QtMultiSpinBoxPrivate* d; // GUI thread only, reset when the spin box is destroyed
+
+protected:
+    bool event(QEvent* e)
+    {
+        if (e->type() != QtMultiSpinBoxAsyncEvent::eventType())
+            return QObject::event(e);
+        QtMultiSpinBoxAsyncEvent* ae = static_cast<QtMultiSpinBoxAsyncEvent*>(e);
+        if (d) {
+            if (ae->kind == QtMultiSpinBoxAsyncEvent::Result)
+                d->applyAsyncResult(ae->section, ae->request, ae->state, ae->text);
+            else
+                d->updateSectionMarks();
+        }
+        return true;
+    }
+
+private:
+    mutable QMutex mutex;
+    QHash<int, int> latest; // section -> last request
+    QSet<const QtMultiSpinBoxElement*> live;
+    QHash<const QtMultiSpinBoxElement*, int> running;
+    QWaitCondition released;
+};
+
+
+class QtMultiSpinBoxAsyncTask : public QRunnable
+{
+public:
+    QtMultiSpinBoxAsyncTask(const QSharedPointer<QtMultiSpinBoxAsyncRelay>& relay,
+                            const QtMultiSpinBoxElement* element,
+                            int section, int request, const QString& text) :
+        m_relay(relay),
+        m_element(element),
+        m_section(section),
+        m_request(request),
+        m_text(text)
+    {
+    }
+
+    void run()
+    {
+        // a newer input of the section made this check useless
+        if (!m_relay->isLatest(m_section, m_request))
+            return;
+        // removed from the spin box (maybe deleted) since the request
+        if (!m_relay->acquire(m_element))
+            return;
+        QtMultiSpinBoxAsyncEvent* e = new QtMultiSpinBoxAsyncEvent(QtMultiSpinBoxAsyncEvent::Result);
+        e->section = m_section;
+        e->request = m_request;
+        e->state = m_element->validateAsync(m_text);
+        e->text = m_text;
+        m_relay->release(m_element);
+        QCoreApplication::postEvent(m_relay.data(), e);
+    }
+
+private:
+    QSharedPointer<QtMultiSpinBoxAsyncRelay> m_relay;
+    const QtMultiSpinBoxElement* m_element;
+    int m_section;
+    int m_request;
+    QString m_text;
+};
+
+
 //==============================================================================
 
 
 QtMultiSpinBoxPrivate::QtMultiSpinBoxPrivate(QtMultiSpinBox *s) :
+    notAcceptableCount(0),
+    layoutValid(false),
+    asyncRequestCounter(0),
+    sectionMarksDirty(false),
+    propagatingConstraints(false),
+    textPending(false),
+    extentsValid(false),
+    prefixAdvance(0),
+    highlight(0),
+    statusMarks(0),
     q_ptr(s)
 {
     clear();
@@ -294,82 +1043,125 @@ QtMultiSpinBoxPrivate::QtMultiSpinBoxPrivate(QtMultiSpinBox *s) :
     Q_Q(QtMultiSpinBox);
     q->connect(q->lineEdit(), SIGNAL(cursorPositionChanged(int,int)),
                q, SLOT(_q_cursorPositionChanged(int,int)));
+    q->connect(q, SIGNAL(editingFinished()),
+               q, SLOT(_q_editingFinished()));
+    q->connect(q->lineEdit(), SIGNAL(textChanged(QString)),
+               q, SLOT(_q_textChanged()));
+    // middle click and drop: see QtMultiSpinBox::eventFilter
+    q->lineEdit()->installEventFilter(q);
 }
 
 
 QtMultiSpinBoxPrivate::~QtMultiSpinBoxPrivate()
 {
-    qDeleteAll(elementDatas);
+    if (asyncRelay) {
+        asyncRelay->d = 0;
+        asyncRelay->clearRequests();
+        // the elements are often children of the spin box, deleted next
+        retireAsyncChecks(0, engine.count());
+    }
+    qDeleteAll(constraints);
 }
 
 
 void QtMultiSpinBoxPrivate::clear()
 {
     currentSectionIndex = -1;
-    prefix.resize(0);
-    elementDatas.clear();
+    retireAsyncChecks(0, engine.count());
+    engine.clear();
+    invalidateLayout();
+    textPending = false;
+    pendingTexts.clear();
 
     Q_Q(QtMultiSpinBox);
     q->lineEdit()->clear();
+    resetJournalValues();
 }
 
 
 void QtMultiSpinBoxPrivate::insert(int index, QtMultiSpinBoxElement* element, const QString &suffix)
 {
+    QMSBTRACE("insert");
     Q_Q(QtMultiSpinBox);
 
+    if (deferText()) {
+        QString defaultText = element->memoTextFromValue(element->defaultValue());
+        if (defaultText.isNull())
+            qWarning("QtMultiSpinBox:  text of default value is invalid");
+        engine.insertElement(index, element, suffix);
+        pendingTexts.insert(index, defaultText.simplified());
+        invalidateLayout();
+        journalValues.clear();
+        return;
+    }
+
     QString text = q->lineEdit()->text();
-    int startIndexElement = textIndex(text, index);
+    int startIndexElement = syncLayout() ? sectionStart(index) : engine.textIndex(text, index);
     Q_ASSERT(startIndexElement >= 0);
     QMSBDEBUG(DBG_LEVEL_INSERT) << "insert at" << index
                                 << "previous" << text
                                 << "text_index" << startIndexElement;
 
     // index is valid, element not null
-    QtMultiSpinBoxData* newElement = new QtMultiSpinBoxData(element, suffix);
-    elementDatas.insert(index, newElement);
+    engine.insertElement(index, element, suffix);
+    invalidateLayout();
 
-    QString defaultText = element->textFromValue(element->defaultValue());
+    QString defaultText = element->memoTextFromValue(element->defaultValue());
     if (defaultText.isNull())
         qWarning("QtMultiSpinBox:  text of default value is invalid");
     QMSBDEBUG(DBG_LEVEL_INSERT) << "default text" << defaultText
-                                << "suffix" << newElement->suffix;
+                                << "suffix" << engine.suffix(index);
 
     // inserting text
-    text.insert(startIndexElement, defaultText.simplified() + newElement->suffix);
+    text.insert(startIndexElement, defaultText.simplified() + engine.suffix(index));
     QMSBDEBUG(DBG_LEVEL_INSERT) << "final text" << text;
+    counters.count(QtMultiSpinBoxStatistics::TextRewrites);
     q->lineEdit()->setText(text);
     q->lineEdit()->setCursorPosition(startIndexElement);
+    resetJournalValues();
 }
 
 
-QtMultiSpinBoxData* QtMultiSpinBoxPrivate::take(int index)
+QtMultiSpinBoxElement* QtMultiSpinBoxPrivate::take(int index)
 {
+    QMSBTRACE("take");
     Q_Q(QtMultiSpinBox);
+    retireAsyncChecks(index, 1);
+
+    if (deferText()) {
+        pendingTexts.removeAt(index);
+        invalidateLayout();
+        journalValues.clear();
+        return engine.takeElement(index);
+    }
 
     QString text = q->lineEdit()->text();
-    int startIndexElement = textIndex(text, index);
-    int endIndexElement = (index+1 == elementDatas.count())
-            ? text.length() : textIndex(text, index+1);
+    bool synced = syncLayout();
+    int startIndexElement = synced ? sectionStart(index) : engine.textIndex(text, index);
+    int endIndexElement = (index+1 == engine.count())
+            ? text.length() : (synced ? sectionStart(index+1) : engine.textIndex(text, index+1));
     Q_ASSERT(startIndexElement >= 0);
     Q_ASSERT(endIndexElement >= 0);
 
     // index is valid, element exist
-    QtMultiSpinBoxData* takenElementData = elementDatas.takeAt(index);
+    QtMultiSpinBoxElement* takenElement = engine.takeElement(index);
+    invalidateLayout();
 
     // removing text
     text.remove(startIndexElement, endIndexElement - startIndexElement);
+    counters.count(QtMultiSpinBoxStatistics::TextRewrites);
     q->lineEdit()->setText(text);
     q->lineEdit()->setCursorPosition(0);
+    resetJournalValues();
 
-    return takenElementData;
+    return takenElement;
 }
 
 
 QtMultiSpinBoxData* QtMultiSpinBoxPrivate::get(int index) const
 {
     // index is valid, element exist
-    return elementDatas.value(index);
+    return engine.data(index);
 }
 
 
@@ -379,177 +1171,742 @@ QtMultiSpinBoxData* QtMultiSpinBoxPrivate::get(int index) const
 void QtMultiSpinBoxPrivate::_q_cursorPositionChanged(int, int new_)
 {
     Q_Q(QtMultiSpinBox);
-    QList<QStringRef> splits;
-    Q_ASSERT(checkAndSplit(q->text(), splits));
-    int indexSplit = 0; // default is invalid
-    bool ok = false;
-    while (indexSplit < splits.count() && !ok) {
-        QStringRef r = splits.value(indexSplit);
-        ok = qIsBetweenEqual(r.position(), r.position() + r.length(), new_);
-        indexSplit++;
-    }
-    if (!ok)
-        indexSplit = -1;
-    else
-        indexSplit--;
+    int indexSplit = syncLayout() ? sectionIndexAt(new_) : -1;
     // it can not found it (because it exclude prefix and suffixes)
     if (currentSectionIndex != indexSplit) {
         currentSectionIndex = indexSplit;
         Q_EMIT q->currentSectionIndexChanged(currentSectionIndex);
     }
+    // also when the line edit scrolled
+    updateHighlight();
+    if (statusMarks)
+        updateSectionMarks();
+}
+
+void QtMultiSpinBoxPrivate::_q_editingFinished()
+{
+    Q_Q(QtMultiSpinBox);
+    // typed input: journaled and derived sections updated once the editing is
+    // done (emitted on each focus out: half typed text is not journaled)
+    if (q->lineEdit()->hasAcceptableInput())
+        journalChanges(0, engine.count() - 1, QtMultiSpinBoxChange::Edited);
+    propagateConstraints();
+}
+
+void QtMultiSpinBoxPrivate::_q_textChanged()
+{
+    Q_Q(QtMultiSpinBox);
+    updateHighlight();
+    if (statusMarks)
+        updateSectionMarks();
+    Q_EMIT q->valuesChanged();
 }
 
 
 //-----------------------------------------------------------------------------
+// text handles (parsing and formatting in QtMultiSpinBoxEngine)
 
 
-QString QtMultiSpinBoxPrivate::simplify(const QString& text) const
+QValidator::State QtMultiSpinBoxPrivate::validate(QString &text, int &pos) const
 {
-    const QChar blank = QLatin1Char(' ');
-    if (text.isEmpty())
-        return text;
-    QString s = text.simplified();
-    bool wasEmpty = s.isEmpty();
-    // re-add first whitespaces
-    for (int index=0; index < text.length() && text.at(index).isSpace(); index++)
-        s.insert(index, blank);
-    if (!wasEmpty) {
-        // re-add last whitespaces
-        for (int index = 0; index < text.length() && text.at(text.length() - index-1).isSpace(); index++)
-            s.insert(s.length() - index, blank);
+    QMSBTRACE("validate");
+    QMSBLATENCY(counters.validateLatency);
+    counters.count(QtMultiSpinBoxStatistics::Validations);
+
+    // only the sections around the change are split and validated again,
+    // the states of the others are kept from their last validation
+    int first = 0;
+    QVector<int> lengths;
+    if (!splitSections(text, first, lengths)) {
+        counters.count(QtMultiSpinBoxStatistics::RejectedInputs);
+        return QValidator::Invalid;
     }
-    return s;
+
+    int offsetReplace = layoutValid ? sectionStart(first) : engine.prefix().length();
+    int shift = 0;
+    QString newText(text);
+    QVector<QValidator::State> states(lengths.count());
+    QVector<int> asyncSections; // acceptable by the cheap check, validateAsync() decides
+    for (int k=0; k < lengths.count(); k++) {
+        QtMultiSpinBoxData* e = engine.data(first + k);
+        QString copy = text.mid(offsetReplace, lengths.at(k));
+        QString sval = copy;
+        QValidator::State rs = e->element->memoValidate(sval, pos);
+        QMSBDEBUG(DBG_LEVEL_VALIDATE) << "validate  index=" << offsetReplace << " text=" << copy;
+        if (rs == QValidator::Invalid) {
+            QMSBDEBUG(DBG_LEVEL_VALIDATE) << "validate  result for" << text << "Invalid";
+            counters.count(QtMultiSpinBoxStatistics::RejectedInputs);
+            return QValidator::Invalid;
+        }
+        states[k] = rs;
+        // pending until validateAsync() answers
+        if (rs == QValidator::Acceptable && e->element->hasAsyncValidation()) {
+            states[k] = QValidator::Intermediate;
+            asyncSections.append(first + k);
+        }
+
+        if (sval != copy) {
+            newText.replace(offsetReplace + shift, copy.length(), sval);
+            shift += sval.length() - copy.length();
+            lengths[k] = sval.length();
+        }
+        offsetReplace += copy.length() + e->suffix.length();
+    }
+
+    // unchanged sections: validated again if their element changed since
+    // (range, decimals...) or if never validated, and all of them when the
+    // text is the same (hasAcceptableInput, end of editing...)
+    QVector<int> recheckedSections;
+    QVector<QValidator::State> recheckedStates;
+    if (layoutValid) {
+        const bool sameText = lengths.isEmpty();
+        for (int i=0; i < engine.count(); i++) {
+            if (i >= first && i < first + lengths.count())
+                continue;
+            const QtMultiSpinBoxElement* element = engine.element(i);
+            if (!sameText && sectionGenerations.at(i) == element->generation())
+                continue;
+            // same text as in the current layout, any fixed text is ignored
+            QString sval = sectionRef(i).toString();
+            int spos = 0;
+            QValidator::State rs = element->memoValidate(sval, spos);
+            if (rs == QValidator::Invalid) {
+                counters.count(QtMultiSpinBoxStatistics::RejectedInputs);
+                return QValidator::Invalid;
+            }
+            // kept only if accepted by validateAsync() for the same element settings
+            if (rs == QValidator::Acceptable && element->hasAsyncValidation()
+                    && !(sectionStates.at(i) == QValidator::Acceptable && sectionGenerations.at(i) == element->generation())) {
+                rs = QValidator::Intermediate;
+                if (sectionGenerations.at(i) != element->generation())
+                    asyncSections.append(i);
+            }
+            recheckedSections.append(i);
+            recheckedStates.append(rs);
+        }
+    }
+
+    // the line edit sets this text next: no split at the next read
+    adoptLayout(newText, first, lengths, &states);
+    for (int k=0; k < recheckedSections.count(); k++) {
+        const int i = recheckedSections.at(k);
+        // not acceptable by the cheap check: no use asking validateAsync()
+        if (recheckedStates.at(k) != QValidator::Acceptable && sectionGenerations.at(i) != engine.element(i)->generation())
+            setAsyncStatus(i, AsyncNone);
+        setSectionState(i, recheckedStates.at(k));
+        sectionGenerations[i] = engine.element(i)->generation();
+    }
+    for (int k=0; k < asyncSections.count(); k++)
+        requestAsyncValidation(asyncSections.at(k), sectionRef(asyncSections.at(k)).toString());
+    for (int k=0; k < lengths.count(); k++) {
+        if (!constraints.isEmpty())
+            changedSections.insert(first + k);
+    }
+    text.swap(newText);
+    QValidator::State r = (notAcceptableCount > 0) ? QValidator::Intermediate : QValidator::Acceptable;
+    QMSBDEBUG(DBG_LEVEL_VALIDATE) << "validate  result for" << text  << ((r == QValidator::Acceptable) ? "acceptable" : "intermediate");
+    return r;
 }
 
+void QtMultiSpinBoxPrivate::fixup(QString &text) const
+{
+    // each element fixes its section (bottom of a range, nearest allowed value...)
+    QList<QStringRef> splits;
+    if (!engine.checkAndSplit(text, splits))
+        return;
+    QStringList texts;
+    texts.reserve(splits.count());
+    bool changed = false;
+    for (int i=0; i < splits.count(); i++) {
+        QString sectionText = splits.at(i).toString();
+        // acceptable sections are kept (QIntValidator::fixup adds group separators)
+        QString checked = sectionText;
+        int pos = 0;
+        const QtMultiSpinBoxElement* element = get(i)->element;
+        if (element->memoValidate(checked, pos) != QValidator::Acceptable) {
+            element->fixup(sectionText);
+            changed = changed || (splits.at(i) != sectionText);
+        }
+        texts.append(sectionText);
+    }
+    if (!changed)
+        return;
+    // a fixed section must not break the split (separator equal to a suffix...)
+    QString fixed = engine.setTextsAt(text, 0, texts);
+    QList<QStringRef> fixedSplits;
+    if (!engine.checkAndSplit(fixed, fixedSplits) || fixedSplits.count() != texts.count())
+        return;
+    for (int i=0; i < texts.count(); i++) {
+        if (fixedSplits.at(i) != texts.at(i))
+            return;
+    }
+    text = fixed;
+}
+
+void QtMultiSpinBoxPrivate::changeText(QLineEdit* edit, const QString& text) const
+{
+    QMSBTRACE("changeText");
+    counters.count(QtMultiSpinBoxStatistics::TextRewrites);
+    int pos = edit->cursorPosition();
+    edit->setText(text);
+    edit->setCursorPosition(pos);
+}
 
 //-----------------------------------------------------------------------------
-// text handles
+// layout of the current text
 
 
-bool QtMultiSpinBoxPrivate::checkAndSplit(const QString& input, QList<QStringRef>& result) const
+bool QtMultiSpinBoxPrivate::deferText()
 {
-    QStringRef r = QStringRef(&input);
-    if (!prefix.isEmpty()) {
-        if (!r.startsWith(prefix, Qt::CaseSensitive)) {
-            QMSBDEBUG(DBG_LEVEL_CHECKANDSPLIT) << "checkAndSplit: invalid prefix";
-            return false;
+    Q_Q(QtMultiSpinBox);
+    if (q->isVisible()) {
+        ensureText();
+        return false;
+    }
+    if (textPending)
+        return true;
+    // keep the section texts, the text is built again from them
+    if (!syncLayout())
+        return false;
+    pendingTexts.clear();
+    pendingTexts.reserve(engine.count());
+    for (int i=0; i < engine.count(); i++)
+        pendingTexts.append(sectionRef(i).toString());
+    textPending = true;
+    return true;
+}
+
+void QtMultiSpinBoxPrivate::ensureText() const
+{
+    if (!textPending)
+        return;
+    QMSBTRACE("ensureText");
+    Q_Q(const QtMultiSpinBox);
+    textPending = false;
+
+    QString text = engine.prefix();
+    for (int i=0; i < engine.count(); i++) {
+        text += pendingTexts.at(i);
+        text += engine.suffix(i);
+    }
+    pendingTexts.clear();
+    layoutValid = false;
+    counters.count(QtMultiSpinBoxStatistics::TextRewrites);
+    q->lineEdit()->setText(text);
+    q->lineEdit()->setCursorPosition(0);
+    resetJournalValues();
+}
+
+bool QtMultiSpinBoxPrivate::syncLayout() const
+{
+    Q_Q(const QtMultiSpinBox);
+    ensureText();
+    // implicitly shared: while currentText holds the buffer, the line edit
+    // detaches on change, so the same buffer means the same text
+    QString text = q->lineEdit()->text();
+    if (layoutValid
+            && text.constData() == currentText.constData()
+            && text.length() == currentText.length())
+        return true;
+
+    int first = 0;
+    QVector<int> lengths;
+    if (!splitSections(text, first, lengths)) {
+        layoutValid = false;
+        return false;
+    }
+    adoptLayout(text, first, lengths, 0);
+    return true;
+}
+
+bool QtMultiSpinBoxPrivate::splitSections(const QString& text, int& first, QVector<int>& lengths) const
+{
+    QMSBTRACE("splitSections");
+    counters.count(QtMultiSpinBoxStatistics::Splits);
+    lengths.clear();
+    if (!text.startsWith(engine.prefix(), Qt::CaseSensitive))
+        return false;
+
+    const int n = engine.count();
+    int start = engine.prefix().length();
+    int stableFrom = -1; // the text is unchanged from there (-1: split all)
+    int delta = 0;
+    first = 0;
+    if (layoutValid) {
+        const int oldLength = currentText.length();
+        const int newLength = text.length();
+        const int maxCommon = qMin(oldLength, newLength);
+        const QChar* o = currentText.constData();
+        const QChar* t = text.constData();
+        int head = 0;
+        while (head < maxCommon && o[head] == t[head])
+            head++;
+        if (head == oldLength && head == newLength) {
+            first = n; // same text
+            return true;
+        }
+        int tail = 0;
+        while (tail < maxCommon - head && o[oldLength-1-tail] == t[newLength-1-tail])
+            tail++;
+        stableFrom = newLength - tail;
+        delta = newLength - oldLength;
+        // sections before the one containing the first change are unchanged
+        if (n > 0 && head > engine.prefix().length()) {
+            first = qMin(offsets.countUpTo(head - engine.prefix().length()), n-1);
+            start = sectionStart(first);
         }
-        r = r.mid(prefix.length());
     }
-    QList<QtMultiSpinBoxData*>::const_iterator it;
-    for (it = elementDatas.constBegin(); it != elementDatas.constEnd(); ++it) {
-        if (!(*it)->suffix.isEmpty()) {
-            int index = r.indexOf((*it)->suffix, 0, Qt::CaseSensitive);
+
+    int pos = start;
+    for (int i = first; i < n; i++) {
+        const QString& suffix = engine.suffix(i);
+        if (!suffix.isEmpty()) {
+            int index = text.indexOf(suffix, pos, Qt::CaseSensitive);
             if (index < 0) {
-                QMSBDEBUG(DBG_LEVEL_CHECKANDSPLIT) << "checkAndSplit: cannot find next suffix";
-                break;
+                QMSBDEBUG(DBG_LEVEL_CHECKANDSPLIT) << "splitSections: cannot find next suffix";
+                return false;
             }
-            QMSBDEBUG(DBG_LEVEL_CHECKANDSPLIT) << "checkAndSplit: add" << r.mid(0, index);
-            result.append(r.mid(0, index));
-            r = r.mid(index + (*it)->suffix.length());
+            lengths.append(index - pos);
+            pos = index + suffix.length();
         }
         else {
             // this should be the last one
-            result.append(r);
-            QMSBDEBUG(DBG_LEVEL_CHECKANDSPLIT) << "checkAndSplit: add" << r;
-            r.clear();
-            ++it;
-            QMSBDEBUG(DBG_LEVEL_CHECKANDSPLIT) << "checkAndSplit: empty suffix found, it should the last";
-            break;
+            if (i+1 != n)
+                return false;
+            lengths.append(text.length() - pos);
+            pos = text.length();
         }
+        // back on a previous boundary in the unchanged end: same split from there
+        if (stableFrom >= 0 && i+1 < n && pos >= stableFrom && pos - delta == sectionStart(i+1))
+            return true;
     }
-    QMSBDEBUG(DBG_LEVEL_CHECKANDSPLIT) << "checkAndSplit: result for" << input << (bool)(it == elementDatas.constEnd() && r.length() == 0);
-    return (it == elementDatas.constEnd() && r.length() == 0);
+    return pos == text.length();
 }
 
-int QtMultiSpinBoxPrivate::textIndex(const QString& text, int indexElement) const
+void QtMultiSpinBoxPrivate::adoptLayout(const QString& text, int first, const QVector<int>& lengths,
+                                        const QVector<QValidator::State>* states) const
 {
-    int index = 0;
-    if (!prefix.isEmpty()) {
-        if (!text.startsWith(prefix, Qt::CaseSensitive))
-            return -1;
-        else
-            index += prefix.length();
-    }
-    Q_ASSERT(indexElement <= elementDatas.count());
-    for (int i=0; i<indexElement && index >= 0; i++) {
-        QtMultiSpinBoxData* e = elementDatas.value(i);
-        if (!e->suffix.isEmpty()) {
-            index = text.indexOf(e->suffix, index, Qt::CaseSensitive);
-            if (index >= 0)
-                index += e->suffix.length();
+    currentText = text;
+    if (!layoutValid) {
+        const int n = engine.count();
+        Q_ASSERT(first == 0 && lengths.count() == n);
+        sectionLengths = lengths;
+        QVector<int> spans(n);
+        for (int i=0; i < n; i++)
+            spans[i] = lengths.at(i) + engine.suffix(i).length();
+        offsets.reset(spans);
+        sectionStates.fill(QValidator::Acceptable, n);
+        sectionGenerations.fill(-1, n);
+        notAcceptableCount = 0;
+        asyncStatus.fill(AsyncNone, n);
+        if (asyncRelay) {
+            // sections may have moved: drop all pending checks
+            asyncRelay->clearRequests();
+            sectionMarksDirty = false;
+            setAsyncStatus(-1, AsyncNone);
         }
-        else {
-            // this must be the last one
-            if (i+1 == indexElement && indexElement == elementDatas.count())
-                index = text.length();
-            else
-                index = -1;
-            break;
+        extentsValid = false;
+        layoutValid = true;
+    }
+    else {
+        for (int k=0; k < lengths.count(); k++) {
+            offsets.add(first + k, lengths.at(k) - sectionLengths.at(first + k));
+            sectionLengths[first + k] = lengths.at(k);
+        }
+        // measured again on next query, all of them if many changed
+        if (extentsValid) {
+            if (dirtyExtents.count() + lengths.count() > engine.count())
+                extentsValid = false;
+            else {
+                for (int k=0; k < lengths.count(); k++)
+                    dirtyExtents.append(first + k);
+            }
+        }
+    }
+    // text adopted without validation (syncLayout): intermediate until the
+    // next validate() checks it
+    for (int k=0; k < lengths.count(); k++) {
+        const int i = first + k;
+        setSectionState(i, states ? states->at(k) : QValidator::Intermediate);
+        sectionGenerations[i] = states ? engine.element(i)->generation() : -1;
+        setAsyncStatus(i, AsyncNone);
+    }
+}
+
+void QtMultiSpinBoxPrivate::setSectionState(int index, QValidator::State state) const
+{
+    if (sectionStates.at(index) != QValidator::Acceptable)
+        notAcceptableCount--;
+    if (state != QValidator::Acceptable)
+        notAcceptableCount++;
+    sectionStates[index] = state;
+}
+
+void QtMultiSpinBoxPrivate::ensureExtents() const
+{
+    Q_Q(const QtMultiSpinBox);
+    const QFontMetrics fm = q->lineEdit()->fontMetrics();
+    const int n = engine.count();
+    if (!extentsValid || sectionAdvances.count() != n) {
+        prefixAdvance = qmsbHorizontalAdvance(fm, engine.prefix());
+        sectionAdvances.resize(n);
+        QVector<int> spans(n);
+        for (int i=0; i < n; i++) {
+            sectionAdvances[i] = qmsbHorizontalAdvance(fm, sectionRef(i).toString());
+            spans[i] = sectionAdvances.at(i) + qmsbHorizontalAdvance(fm, engine.suffix(i));
         }
+        advanceOffsets.reset(spans);
+        extentsValid = true;
+    }
+    else {
+        foreach (int i, dirtyExtents) {
+            const int advance = qmsbHorizontalAdvance(fm, sectionRef(i).toString());
+            advanceOffsets.add(i, advance - sectionAdvances.at(i));
+            sectionAdvances[i] = advance;
+        }
+    }
+    dirtyExtents.clear();
+}
+
+int QtMultiSpinBoxPrivate::advanceTo(int position) const
+{
+    Q_Q(const QtMultiSpinBox);
+    const QFontMetrics fm = q->lineEdit()->fontMetrics();
+    const int prefixLength = engine.prefix().length();
+    const int n = engine.count();
+    if (n == 0 || position <= prefixLength)
+        return qmsbHorizontalAdvance(fm, engine.prefix().left(position));
+    const int index = qMin(offsets.countUpTo(position - prefixLength), n-1);
+    const int start = sectionStart(index);
+    return prefixAdvance + advanceOffsets.sum(index) + qmsbHorizontalAdvance(fm, currentText.mid(start, position - start));
+}
+
+QRect QtMultiSpinBoxPrivate::sectionRect(int index) const
+{
+    Q_Q(const QtMultiSpinBox);
+    // the line edit alignment and scrolling are known from its cursor
+    const QLineEdit* edit = q->lineEdit();
+    const QRect cursor = edit->cursorRect();
+    const int origin = cursor.center().x() - advanceTo(edit->cursorPosition());
+    QRect rect(origin + prefixAdvance + advanceOffsets.sum(index), cursor.top(),
+               sectionAdvances.at(index), cursor.height());
+    return rect.translated(edit->geometry().topLeft());
+}
+
+void QtMultiSpinBoxPrivate::updateHighlight() const
+{
+    Q_Q(const QtMultiSpinBox);
+    // hidden: the pending text is not built for it
+    if (!highlight || !q->isVisible())
+        return;
+    QRect rect;
+    if (currentSectionIndex >= 0 && syncLayout() && currentSectionIndex < engine.count()) {
+        ensureExtents();
+        const QLineEdit* edit = q->lineEdit();
+        rect = sectionRect(currentSectionIndex).translated(-edit->geometry().topLeft()) & edit->rect();
+    }
+    if (rect.isEmpty())
+        highlight->hide();
+    else {
+        highlight->setGeometry(rect);
+        highlight->show();
     }
+}
+
+int QtMultiSpinBoxPrivate::sectionIndexAt(int position) const
+{
+    const int n = engine.count();
+    if (n == 0 || position < engine.prefix().length())
+        return -1;
+    int index = qMin(offsets.countUpTo(position - engine.prefix().length()), n-1);
+    // in the text of the section or just after, not in its suffix
+    if (position > sectionStart(index) + sectionLength(index))
+        return -1;
     return index;
 }
 
-QValidator::State QtMultiSpinBoxPrivate::validate(QString &text, int &pos) const
+QString QtMultiSpinBoxPrivate::replacedSection(int index, const QString& sectionText) const
 {
-    QList<QStringRef> splits;
-    if (!checkAndSplit(text, splits))
-        return QValidator::Invalid;
+    return QString(currentText).replace(sectionStart(index), sectionLength(index), sectionText);
+}
 
-    int offsetReplace = prefix.length();
-    QString newText(text);
-    QValidator::State r = QValidator::Acceptable;
-    foreach (QtMultiSpinBoxData* e, elementDatas) {
-        QStringRef ref = splits.takeFirst();
-        QString copy = ref.toString();
-        QString sval = copy;
-        QValidator::State rs = e->element->validate(sval, pos);
-        QMSBDEBUG(DBG_LEVEL_VALIDATE) << "validate  index=" << offsetReplace << " text=" << copy;
-        if (rs == QValidator::Invalid) {
-            QMSBDEBUG(DBG_LEVEL_VALIDATE) << "validate  result for" << text << "Invalid";
-            return QValidator::Invalid;
+
+QString QtMultiSpinBoxPrivate::replacedSections(const QMap<int, QString>& sectionTexts) const
+{
+    QString result;
+    result.reserve(currentText.length());
+    int pos = 0;
+    QMap<int, QString>::const_iterator it;
+    for (it = sectionTexts.constBegin(); it != sectionTexts.constEnd(); ++it) {
+        int start = sectionStart(it.key());
+        result += currentText.midRef(pos, start - pos);
+        result += it.value();
+        pos = start + sectionLength(it.key());
+    }
+    result += currentText.midRef(pos);
+    return result;
+}
+
+
+//-----------------------------------------------------------------------------
+// constraints
+
+
+void QtMultiSpinBoxPrivate::sortConstraints()
+{
+    // topological order (Kahn): a constraint after those computing its inputs
+    const int n = constraints.count();
+    QVector<QList<int> > next(n);
+    QVector<int> inputCount(n, 0);
+    for (int i=0; i < n; i++) {
+        for (int j=0; j < n; j++) {
+            if (i == j)
+                continue;
+            foreach (int output, constraints.at(i)->outputs()) {
+                if (constraints.at(j)->inputs().contains(output)) {
+                    next[i].append(j);
+                    inputCount[j]++;
+                    break;
+                }
+            }
         }
-        else if (rs == QValidator::Intermediate)
-            r = QValidator::Intermediate;
+    }
 
-        if (sval != copy)
-            newText.replace(offsetReplace, copy.length(), sval);
-        offsetReplace += sval.length() + e->suffix.length();
+    QList<QtMultiSpinBoxConstraint*> sorted;
+    QList<int> ready;
+    for (int i=0; i < n; i++) {
+        if (inputCount.at(i) == 0)
+            ready.append(i);
     }
+    QVector<bool> done(n, false);
+    while (!ready.isEmpty()) {
+        int i = ready.takeFirst();
+        done[i] = true;
+        sorted.append(constraints.at(i));
+        foreach (int j, next.at(i)) {
+            if (--inputCount[j] == 0)
+                ready.append(j);
+        }
+    }
+    if (sorted.count() != n) {
+        qWarning("QtMultiSpinBox: cycle between constraints, computed in insertion order");
+        for (int i=0; i < n; i++) {
+            if (!done.at(i))
+                sorted.append(constraints.at(i));
+        }
+    }
+    constraints = sorted;
+}
 
-    text.swap(newText);
-    QMSBDEBUG(DBG_LEVEL_VALIDATE) << "validate  result for" << text  << ((r == QValidator::Acceptable) ? "acceptable" : "intermediate");
-    return r;
+void QtMultiSpinBoxPrivate::propagateConstraints()
+{
+    if (propagatingConstraints || constraints.isEmpty() || changedSections.isEmpty())
+        return;
+    QMSBTRACE("propagateConstraints");
+    Q_Q(QtMultiSpinBox);
+    if (!syncLayout())
+        return;
+
+    QSet<int> dirty;
+    dirty.swap(changedSections);
+    const int n = engine.count();
+    QMap<int, QVariant> values; // read on demand
+    QMap<int, QString> newTexts;
+    foreach (QtMultiSpinBoxConstraint* c, constraints) {
+        bool changed = false;
+        foreach (int input, c->inputs())
+            changed = changed || dirty.contains(input);
+        if (!changed)
+            continue;
+
+        QVariantList inputValues;
+        foreach (int input, c->inputs()) {
+            if (input < 0 || input >= n)
+                inputValues.append(QVariant());
+            else {
+                if (!values.contains(input))
+                    values.insert(input, get(input)->element->valueFromText(sectionRef(input).toString()));
+                inputValues.append(values.value(input));
+            }
+        }
+
+        QVariantList outputValues = c->compute(inputValues);
+        for (int k=0; k < outputValues.count() && k < c->outputs().count(); k++) {
+            int output = c->outputs().at(k);
+            const QVariant& v = outputValues.at(k);
+            if (output < 0 || output >= n || !v.isValid())
+                continue;
+            QtMultiSpinBoxElement* element = get(output)->element;
+            QString outputText = element->memoTextFromValue(v);
+            int pos = 0;
+            if (outputText.isNull() || element->memoValidate(outputText, pos) == QValidator::Invalid) {
+                qWarning("QtMultiSpinBox: constraint output rejected by section %d", output);
+                continue;
+            }
+            values.insert(output, v);
+            newTexts.insert(output, outputText);
+            dirty.insert(output);
+        }
+    }
+
+    if (newTexts.isEmpty())
+        return;
+    propagatingConstraints = true;
+    changeText(q->lineEdit(), replacedSections(newTexts));
+    changedSections.clear();
+    propagatingConstraints = false;
+    foreach (int output, newTexts.keys())
+        journalChanges(output, output, QtMultiSpinBoxChange::Derived);
+}
+
+
+//-----------------------------------------------------------------------------
+// audit journal
+
+
+void QtMultiSpinBoxPrivate::resetJournalValues() const
+{
+    if (!journal || !syncLayout()) {
+        journalValues.clear();
+        return;
+    }
+    const int n = engine.count();
+    journalValues.resize(n);
+    for (int i=0; i < n; i++) {
+        QVariant v = get(i)->element->valueFromText(sectionRef(i).toString());
+        journalValues[i] = QtMultiSpinBoxJournalValue::fromVariant(v);
+    }
 }
 
-void QtMultiSpinBoxPrivate::fixup(QString &) const
+void QtMultiSpinBoxPrivate::journalChanges(int first, int last, QtMultiSpinBoxChange::Origin origin)
 {
+    if (!journal || first > last || !syncLayout())
+        return;
+    QMSBTRACE("journalChanges");
+    if (journalValues.count() != engine.count()) {
+        // no reference: nothing to compare with
+        resetJournalValues();
+        return;
+    }
 
+    qint64 timestamp = 0;
+    for (int i = first; i <= last; i++) {
+        QVariant v = get(i)->element->valueFromText(sectionRef(i).toString());
+        if (!v.isValid())
+            continue; // no value yet (empty section...): journaled once typed
+        QtMultiSpinBoxJournalValue value = QtMultiSpinBoxJournalValue::fromVariant(v);
+        if (value == journalValues.at(i))
+            continue;
+        if (timestamp == 0)
+            timestamp = QDateTime::currentMSecsSinceEpoch();
+        QtMultiSpinBoxChange change;
+        change.timestamp = timestamp;
+        change.section = i;
+        change.origin = origin;
+        change.oldValue = journalValues.at(i);
+        change.newValue = value;
+        journal->append(change);
+        journalValues[i] = value;
+    }
 }
 
-QString QtMultiSpinBoxPrivate::textAt(const QString& input, int index) const
+
+//-----------------------------------------------------------------------------
+// asynchronous validation
+
+
+void QtMultiSpinBoxPrivate::requestAsyncValidation(int index, const QString& sectionText) const
 {
-    QList<QStringRef> splits;
-    Q_ASSERT(checkAndSplit(input, splits));
-    Q_ASSERT(index >= 0 && index < splits.count());
-    return splits.value(index).toString();
+    if (!asyncRelay) {
+        QtMultiSpinBoxPrivate* self = const_cast<QtMultiSpinBoxPrivate*>(this);
+        asyncRelay = QSharedPointer<QtMultiSpinBoxAsyncRelay>(new QtMultiSpinBoxAsyncRelay(self),
+                                                              &QObject::deleteLater);
+    }
+    int request = ++asyncRequestCounter;
+    asyncRelay->setLatest(index, request);
+    asyncRelay->enlist(get(index)->element);
+    setAsyncStatus(index, AsyncPending);
+    QThreadPool::globalInstance()->start(new QtMultiSpinBoxAsyncTask(asyncRelay, get(index)->element,
+                                                                     index, request, sectionText));
 }
 
-QString QtMultiSpinBoxPrivate::setTextAt(const QString& input, int index, const QString &text) const
+void QtMultiSpinBoxPrivate::retireAsyncChecks(int first, int count) const
 {
-    QList<QStringRef> splits;
-    Q_ASSERT(checkAndSplit(input, splits));
-    Q_ASSERT(index >= 0 && index < splits.count());
-    QStringRef r = splits.value(index);
-    return QString(input).replace(r.position(), r.length(), text);
+    if (!asyncRelay)
+        return;
+    for (int i=first; i < first + count; i++) {
+        if (engine.element(i)->hasAsyncValidation())
+            asyncRelay->retire(engine.element(i));
+    }
 }
 
-void QtMultiSpinBoxPrivate::changeText(QLineEdit* edit, const QString& text) const
+void QtMultiSpinBoxPrivate::applyAsyncResult(int index, int request, QValidator::State state, const QString& sectionText)
 {
-    int pos = edit->cursorPosition();
-    edit->setText(text);
-    edit->setCursorPosition(pos);
+    if (!asyncRelay || !asyncRelay->isLatest(index, request))
+        return;
+    asyncRelay->finish(index, request);
+    // the section changed since the request
+    if (!syncLayout() || index >= engine.count() || sectionRef(index) != sectionText)
+        return;
+
+    // the lowest of the cheap and the async states (the element may have
+    // changed since the request); an invalid section keeps the whole text
+    // intermediate, and is shown as rejected
+    QString sval = sectionText;
+    int spos = 0;
+    const QValidator::State syncState = get(index)->element->memoValidate(sval, spos);
+    const QValidator::State combined = qMin(syncState, state);
+    setSectionState(index, (combined == QValidator::Acceptable) ? QValidator::Acceptable : QValidator::Intermediate);
+    setAsyncStatus(index, (state == QValidator::Invalid) ? AsyncRejected : AsyncNone);
+}
+
+void QtMultiSpinBoxPrivate::setAsyncStatus(int index, AsyncStatus status) const
+{
+    // index -1: marks only
+    if (index >= 0) {
+        if (asyncStatus.at(index) == status)
+            return;
+        asyncStatus[index] = status;
+    }
+    if (!sectionMarksDirty && asyncRelay) {
+        sectionMarksDirty = true;
+        QCoreApplication::postEvent(asyncRelay.data(),
+                                    new QtMultiSpinBoxAsyncEvent(QtMultiSpinBoxAsyncEvent::RefreshMarks));
+    }
+}
+
+void QtMultiSpinBoxPrivate::updateSectionMarks() const
+{
+    Q_Q(const QtMultiSpinBox);
+    sectionMarksDirty = false;
+    // hidden: the pending text is not built for it (see showEvent)
+    if (!q->isVisible())
+        return;
+
+    // underlines painted over the line edit, its text and input method are left as is
+    const QLineEdit* edit = q->lineEdit();
+    QVector<QRect> pending;
+    QVector<QRect> rejected;
+    if (syncLayout()) {
+        for (int i=0; i < asyncStatus.count(); i++) {
+            if (asyncStatus.at(i) == AsyncNone)
+                continue;
+            ensureExtents();
+            QRect rect = sectionRect(i).translated(-edit->geometry().topLeft());
+            rect.setWidth(qMax(rect.width(), 4)); // empty section
+            if (asyncStatus.at(i) == AsyncPending)
+                pending.append(rect);
+            else
+                rejected.append(rect);
+        }
+    }
+    if (!statusMarks) {
+        if (pending.isEmpty() && rejected.isEmpty())
+            return;
+        statusMarks = new QtMultiSpinBoxStatusMarks(q->lineEdit());
+    }
+    statusMarks->setGeometry(edit->rect());
+    statusMarks->setMarks(pending, rejected);
 }
 
 QT_END_NAMESPACE
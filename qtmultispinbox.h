@@ -4,6 +4,20 @@
 #include <QList>
 #include <QWidget>
 #include <QAbstractSpinBox>
+#include <QAtomicInt>
+#include <QFontMetrics>
+#include <QMap>
+#include <QPointF>
+#include <QRect>
+#include <QSet>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+#include <QVector3D>
+
+#include "qtmultispinboxengine.h"
+#include "qtmultispinboxjournal.h"
 
 #ifdef QT_NO_VALIDATOR
 #error QtMultiSpinBox require validator
@@ -14,22 +28,85 @@
 QT_BEGIN_NAMESPACE
 
 class QtMultiSpinBoxElement;
+class QtMultiSpinBoxConstraint;
 
 
+// width of a text, QFontMetrics::width is deprecated since Qt 5.11
+inline int qmsbHorizontalAdvance(const QFontMetrics& fm, const QString& text)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+    return fm.horizontalAdvance(text);
+#else
+    return fm.width(text);
+#endif
+}
 
 
-class QtMultiSpinBoxData
+
+
+// snapshot of the work done by a spin box since the last reset
+class QtMultiSpinBoxStatistics
 {
 public:
-    QtMultiSpinBoxData(QtMultiSpinBoxElement* element, const QString &suffix);
+    enum Counter {
+        Validations,    // QValidator::validate of the whole text
+        Splits,         // text split into sections
+        TextRewrites,   // whole text set on the line edit
+        Steps,          // stepBy
+        RejectedInputs, // invalid text or paste
+        CounterCount
+    };
+
+    // bucket 0: [0, 2ns), bucket b: [2^b, 2^(b+1)) ns, the last one is open
+    enum { LatencyBuckets = 32 };
 
-    QtMultiSpinBoxElement* element;
-    QString suffix;
+    QtMultiSpinBoxStatistics();
+
+    static qint64 bucketLowerBound(int bucket) { return (bucket == 0) ? 0 : (Q_INT64_C(1) << bucket); }
+
+    uint counters[CounterCount];
+    uint validateLatency[LatencyBuckets];
+    uint stepLatency[LatencyBuckets];
+};
+
+
+// live counters: relaxed atomic increments only
+class QtMultiSpinBoxCounters
+{
+public:
+    void count(QtMultiSpinBoxStatistics::Counter counter) { counters[counter].fetchAndAddRelaxed(1); }
+    static void addLatency(QAtomicInt* histogram, qint64 ns);
+
+    QtMultiSpinBoxStatistics snapshot() const;
+    void reset();
+
+    QAtomicInt counters[QtMultiSpinBoxStatistics::CounterCount];
+    QAtomicInt validateLatency[QtMultiSpinBoxStatistics::LatencyBuckets];
+    QAtomicInt stepLatency[QtMultiSpinBoxStatistics::LatencyBuckets];
+};
+
+
+
+// section spans (text + suffix) in a Fenwick tree:
+// offset of a section and section at an offset in O(log n)
+class QtMultiSpinBoxOffsets
+{
+public:
+    void reset(const QVector<int>& spans);  // O(n)
+    void add(int index, int delta);         // O(log n)
+    int sum(int count) const;               // total span of sections [0, count)
+    int countUpTo(int offset) const;        // greatest count with sum(count) <= offset
+    int size() const { return qMax(0, m_tree.size() - 1); }
+
+private:
+    QVector<int> m_tree; // 1-based
 };
 
 
 
 class QtMultiSpinBoxPrivate;
+class QtMultiSpinBoxAsyncRelay;
+class QtMultiSpinBoxStatusMarks;
 
 class QtMultiSpinBox : public QAbstractSpinBox
 {
@@ -37,6 +114,10 @@ class QtMultiSpinBox : public QAbstractSpinBox
     Q_PROPERTY(int count READ count)
     Q_PROPERTY(int currentSectionIndex READ currentSectionIndex WRITE setCurrentSectionIndex NOTIFY currentSectionIndexChanged)
     Q_PROPERTY(QString prefix READ prefix WRITE setPrefix)
+    Q_PROPERTY(bool currentSectionHighlighted READ isCurrentSectionHighlighted WRITE setCurrentSectionHighlighted)
+    Q_PROPERTY(QVariantList values READ values WRITE setValues NOTIFY valuesChanged USER true)
+    Q_PROPERTY(QPointF pointValue READ pointValue WRITE setPointValue NOTIFY valuesChanged)
+    Q_PROPERTY(QVector3D vector3DValue READ vector3DValue WRITE setVector3DValue NOTIFY valuesChanged)
 
 
 public:
@@ -58,10 +139,55 @@ public:
     QVariant value(int index) const;
     QString text(int index) const;
 
+    // all sections at once (QPropertyAnimation, QDataWidgetMapper...),
+    // the point and the vector are read from the first 2 or 3 sections
+    QVariantList values() const;
+    QPointF pointValue() const;
+    QVector3D vector3DValue() const;
+
+    // views into the current text, no copy: valid until the text changes
+    // (user edit, setValue, setText, layout change...), then get new ones
+    QStringRef textRef(int index) const;
+    QList<QStringRef> textRefs() const;
+
+    // pixel extents of a section text in widget coordinates, from cached
+    // section widths (only the edited sections are measured again), empty
+    // if the text does not match the layout. Approximate: each prefix,
+    // section and suffix is measured alone, without the kerning and shaping
+    // across their boundaries (a pixel or so, more in cursive scripts)
+    QRect sectionRect(int index) const;
+    // tint behind the current section, moved without repainting the text
+    bool isCurrentSectionHighlighted() const;
+    void setCurrentSectionHighlighted(bool highlighted);
+
+    // values only, joined by separator (decimal commas are kept)
+    QString compactText(const QString& separator = QLatin1String(", ")) const;
+    // accept the full layout or a list of values ("12, -4, 90", "12 -4 90"...)
+    // filled from the current section (or all sections), in one text update
+    bool setCompactText(const QString& text);
+
 
     StepEnabled stepEnabled() const;
     void stepBy(int steps);
 
+    QtMultiSpinBoxStatistics statistics() const;
+    void resetStatistics();
+
+    // derived sections: when inputs change (step, setValue, paste, end of
+    // editing), only the dependent constraints are computed again, in
+    // dependency order, and their outputs set in one text update.
+    // Owned by the spin box, indexes are not updated by insert/remove
+    void addConstraint(QtMultiSpinBoxConstraint* constraint);
+    void clearConstraints();
+    QList<QtMultiSpinBoxConstraint*> constraints() const;
+
+    // audit journal of the committed changes (old and new value of each
+    // section), disabled by default: typed text once acceptable, sections
+    // without a value are skipped. 0 disables it, the journal is kept by its
+    // drainers after that
+    void setJournalCapacity(int capacity);
+    QSharedPointer<QtMultiSpinBoxJournal> journal() const; // null if disabled
+
 
 
 public Q_SLOTS:
@@ -77,19 +203,37 @@ public Q_SLOTS:
     void setSuffix(int index, const QString& suffix);
     void setValue(int index, const QVariant& sectionValue);
     void setText(int index, const QString& sectionText);
+    // one text update, invalid or missing values keep their section
+    void setValues(const QVariantList& values);
+    void setPointValue(const QPointF& point);
+    void setVector3DValue(const QVector3D& vector);
+
+    void copy() const; // compact text to clipboard
+    // compact text from clipboard, or regular line edit paste; the context
+    // menu, middle click and drop of the line edit use it as well
+    void paste();
 
 
 Q_SIGNALS:
     void currentSectionIndexChanged(int index);
+    void valuesChanged();
 
 
 protected:
     QtMultiSpinBox(QAbstractSpinBoxPrivate &dd, QWidget *parent = 0);
 
     void focusInEvent(QFocusEvent* event);
+    void showEvent(QShowEvent* event);
+    void resizeEvent(QResizeEvent* event);
+    void changeEvent(QEvent* event);
+    void keyPressEvent(QKeyEvent* event);
+    void contextMenuEvent(QContextMenuEvent* event);
+    bool eventFilter(QObject* watched, QEvent* event);
 
 private:
     Q_PRIVATE_SLOT(d_func(), void _q_cursorPositionChanged(int,int))
+    Q_PRIVATE_SLOT(d_func(), void _q_editingFinished())
+    Q_PRIVATE_SLOT(d_func(), void _q_textChanged())
 
 
 private:
@@ -115,36 +259,111 @@ public:
     void clear();
 
 
-    // simplify whitespace but do not trimmed
-    QString simplify(const QString& text) const;
-
-
     void insert(int index, QtMultiSpinBoxElement* element, const QString &suffix);
-    QtMultiSpinBoxData* take(int index);
+    QtMultiSpinBoxElement* take(int index);
     QtMultiSpinBoxData* get(int index) const;
 
 
     // slots
     void _q_cursorPositionChanged(int old,int new_);
+    void _q_editingFinished();
+    void _q_textChanged();
 
 
-    int textIndex(const QString &text, int indexElement) const;
-    bool checkAndSplit(const QString &input, QList<QStringRef> &result) const; // chunk of text (no prefix no suffix)
     QValidator::State validate(QString &text, int &pos) const;
     void fixup(QString &) const;
 
-    QString textAt(const QString& input, int index) const;
-    QString setTextAt(const QString& input, int index, const QString &text) const;
-
 
     void changeText(QLineEdit* edit, const QString& text) const;
 
 
+    // layout of the current text: only the sections around a change are split again
+    bool syncLayout() const; // with the line edit text, false if it does not match the layout
+    bool splitSections(const QString& text, int& first, QVector<int>& lengths) const;
+    void adoptLayout(const QString& text, int first, const QVector<int>& lengths,
+                     const QVector<QValidator::State>* states) const;
+    void setSectionState(int index, QValidator::State state) const;
+    void invalidateLayout() { layoutValid = false; }
+    bool deferText();        // true if the text can be left pending
+    void ensureText() const; // build the pending text
+
+    // pixel extents, require a synchronized layout
+    void ensureExtents() const;
+    int advanceTo(int position) const;       // from the start of the text
+    QRect sectionRect(int index) const;      // spin box coordinates
+    void invalidateExtents() const { extentsValid = false; }
+    void updateHighlight() const;            // follow the current section
+
+    // require a synchronized layout
+    int sectionStart(int index) const { return engine.prefix().length() + offsets.sum(index); }
+    int sectionLength(int index) const { return sectionLengths.at(index); }
+    int sectionIndexAt(int position) const; // -1 in prefix or suffixes
+    QStringRef sectionRef(int index) const { return QStringRef(&currentText, sectionStart(index), sectionLength(index)); }
+    QString replacedSection(int index, const QString& sectionText) const;
+
+
+    // asynchronous validation (QtMultiSpinBoxElement::validateAsync)
+    enum AsyncStatus { AsyncNone, AsyncPending, AsyncRejected };
+    void requestAsyncValidation(int index, const QString& sectionText) const;
+    void retireAsyncChecks(int first, int count) const; // before the elements are taken or deleted
+    void applyAsyncResult(int index, int request, QValidator::State state, const QString& sectionText);
+    void setAsyncStatus(int index, AsyncStatus status) const;
+    void updateSectionMarks() const; // underlines of the async states
+
+
+    // constraints between sections
+    void sortConstraints();
+    void propagateConstraints();
+    QString replacedSections(const QMap<int, QString>& sectionTexts) const; // require a synchronized layout
+
+
+    // audit journal: sections compared with their last committed value
+    void resetJournalValues() const;
+    void journalChanges(int first, int last, QtMultiSpinBoxChange::Origin origin);
+
+
 
 public:
     int currentSectionIndex;
-    QString prefix;
-    QList<QtMultiSpinBoxData*> elementDatas;
+    QtMultiSpinBoxEngine engine; // prefix, elements and suffixes
+
+    // current text shares the line edit buffer (no copy), see syncLayout()
+    mutable QString currentText;
+    mutable QVector<int> sectionLengths;
+    mutable QVector<QValidator::State> sectionStates;
+    mutable QVector<int> sectionGenerations; // of the element when validated, -1: not validated
+    mutable int notAcceptableCount;
+    mutable QtMultiSpinBoxOffsets offsets;
+    mutable bool layoutValid;
+
+    mutable QVector<AsyncStatus> asyncStatus;
+    mutable int asyncRequestCounter;
+    mutable bool sectionMarksDirty;
+    mutable QSharedPointer<QtMultiSpinBoxAsyncRelay> asyncRelay; // created on first request
+
+    QList<QtMultiSpinBoxConstraint*> constraints; // dependency order
+    mutable QSet<int> changedSections;            // since the last propagation
+    bool propagatingConstraints;
+
+    QSharedPointer<QtMultiSpinBoxJournal> journal;
+    mutable QVector<QtMultiSpinBoxJournalValue> journalValues; // last committed
+
+    // hidden widget: the layout changes are recorded, the line edit text
+    // is built once on show or on first access (ensureText)
+    mutable bool textPending;
+    mutable QStringList pendingTexts; // section texts while pending
+
+    // widths in the line edit font, measured again only for the sections
+    // changed since the last query (dirtyExtents)
+    mutable bool extentsValid;
+    mutable int prefixAdvance;
+    mutable QVector<int> sectionAdvances;
+    mutable QtMultiSpinBoxOffsets advanceOffsets; // section + suffix widths
+    mutable QVector<int> dirtyExtents;
+    QWidget* highlight; // child of the line edit, 0 if not highlighted
+    mutable QtMultiSpinBoxStatusMarks* statusMarks; // child of the line edit, created on first async state
+
+    mutable QtMultiSpinBoxCounters counters;
 
     QtMultiSpinBox* q_ptr;
 };
@@ -165,6 +384,7 @@ inline bool QtMultiSpinBox::isEmpty() const
 
 inline QString QtMultiSpinBox::text() const
 {
+    d_func()->ensureText();
     return QAbstractSpinBox::text();
 }
 
@@ -0,0 +1,361 @@
+#include "qtmultispinboxbatch.h"
+
+#include <QAtomicInt>
+#include <QFile>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+
+#include "qtmultispinboxelements.h"
+#include "qtmultispinboxtrace.h"
+
+#include <string.h>
+
+
+QT_BEGIN_NAMESPACE
+
+int QtMultiSpinBoxColumn::count() const
+{
+    switch (type) {
+    case QtMultiSpinBoxJournalValue::Int:
+        return ints.count();
+    case QtMultiSpinBoxJournalValue::UInt:
+        return uints.count();
+    default:
+        return doubles.count();
+    }
+}
+
+void QtMultiSpinBoxColumn::reserve(int size)
+{
+    switch (type) {
+    case QtMultiSpinBoxJournalValue::Int:
+        ints.reserve(size);
+        break;
+    case QtMultiSpinBoxJournalValue::UInt:
+        uints.reserve(size);
+        break;
+    default:
+        doubles.reserve(size);
+        break;
+    }
+}
+
+void QtMultiSpinBoxColumn::append(const QVariant& value)
+{
+    switch (type) {
+    case QtMultiSpinBoxJournalValue::Int:
+        ints.append(value.toLongLong());
+        break;
+    case QtMultiSpinBoxJournalValue::UInt:
+        uints.append(value.toULongLong());
+        break;
+    default:
+        doubles.append(value.toDouble());
+        break;
+    }
+}
+
+void QtMultiSpinBoxColumn::append(const QtMultiSpinBoxColumn& other)
+{
+    Q_ASSERT(type == other.type);
+    ints += other.ints;
+    uints += other.uints;
+    doubles += other.doubles;
+}
+
+QVariant QtMultiSpinBoxColumn::value(int row) const
+{
+    switch (type) {
+    case QtMultiSpinBoxJournalValue::Int:
+        return QVariant(ints.at(row));
+    case QtMultiSpinBoxJournalValue::UInt:
+        return QVariant(uints.at(row));
+    default:
+        return QVariant(doubles.at(row));
+    }
+}
+
+
+//==============================================================================
+
+
+namespace {
+
+QAtomicInt qmsbBatchChunkSize(1 << 20);
+
+// Invalid if not stored in a column
+QtMultiSpinBoxColumn::Type qmsbColumnType(const QtMultiSpinBoxElement* element)
+{
+    return QtMultiSpinBoxJournalValue::fromVariant(element->defaultValue()).type;
+}
+
+QVector<QtMultiSpinBoxColumn> qmsbEmptyColumns(const QtMultiSpinBoxEngine& engine)
+{
+    QVector<QtMultiSpinBoxColumn> columns;
+    columns.reserve(engine.count());
+    for (int i=0; i < engine.count(); i++)
+        columns.append(QtMultiSpinBoxColumn(qmsbColumnType(engine.element(i))));
+    return columns;
+}
+
+
+// lines of [begin, end), end is just after a '\n' or the end of the buffer
+class QtMultiSpinBoxParseTask : public QRunnable
+{
+public:
+    QtMultiSpinBoxParseTask(const QtMultiSpinBoxEngine& engine, const char* begin, const char* end) :
+        engine(engine),
+        begin(begin),
+        end(end),
+        lines(0)
+    {
+        setAutoDelete(false);
+    }
+
+    void run()
+    {
+        QMSBTRACE("batchParse");
+        columns = qmsbEmptyColumns(engine);
+        const int n = engine.count();
+        row.resize(n);
+        QList<QStringRef> splits;
+        QString record;
+        for (const char* line = begin; line < end; lines++) {
+            const char* eol = static_cast<const char*>(memchr(line, '\n', end - line));
+            if (!eol)
+                eol = end;
+            int length = eol - line;
+            if (length > 0 && line[length-1] == '\r')
+                length--;
+            if (length > 0 && !parseLine(line, length, n, splits, record))
+                errors.append(lines);
+            line = eol + 1;
+        }
+    }
+
+    bool parseLine(const char* line, int length, int n, QList<QStringRef>& splits, QString& record)
+    {
+        record = QString::fromUtf8(line, length);
+        splits.clear();
+        if (!engine.checkAndSplit(record, splits))
+            return false;
+        QVariant* v = row.data();
+        for (int i=0; i < n; i++) {
+            const QtMultiSpinBoxElement* e = engine.element(i);
+            QString section = splits.at(i).toString();
+            int pos = 0;
+            if (e->validate(section, pos) != QValidator::Acceptable)
+                return false;
+            v[i] = e->valueFromText(section);
+            if (!v[i].isValid())
+                return false;
+        }
+        // all or nothing: the columns stay aligned
+        for (int i=0; i < n; i++)
+            columns[i].append(v[i]);
+        return true;
+    }
+
+    const QtMultiSpinBoxEngine& engine;
+    const char* begin;
+    const char* end;
+    qint64 lines;
+    QVector<qint64> errors; // in the chunk
+    QVector<QtMultiSpinBoxColumn> columns;
+    QVector<QVariant> row;
+};
+
+
+class QtMultiSpinBoxFormatTask : public QRunnable
+{
+public:
+    QtMultiSpinBoxFormatTask(const QtMultiSpinBoxEngine& engine, const QVector<QtMultiSpinBoxColumn>& columns,
+                             int first, int last) :
+        engine(engine),
+        columns(columns),
+        first(first),
+        last(last)
+    {
+        setAutoDelete(false);
+    }
+
+    void run()
+    {
+        QMSBTRACE("batchFormat");
+        const int n = engine.count();
+        QString line;
+        for (int row = first; row < last; row++) {
+            line = engine.prefix();
+            for (int i=0; i < n; i++) {
+                line += engine.element(i)->textFromValue(columns.at(i).value(row));
+                line += engine.suffix(i);
+            }
+            line += QLatin1Char('\n');
+            text += line.toUtf8();
+        }
+    }
+
+    const QtMultiSpinBoxEngine& engine;
+    const QVector<QtMultiSpinBoxColumn>& columns;
+    int first;
+    int last;
+    QByteArray text;
+};
+
+}
+
+
+//------------------------------------------------------------------------------
+
+
+int QtMultiSpinBoxBatch::chunkSize()
+{
+    return qmsbBatchChunkSize.loadAcquire();
+}
+
+void QtMultiSpinBoxBatch::setChunkSize(int size)
+{
+    qmsbBatchChunkSize.storeRelease(qMax(1, size));
+}
+
+bool QtMultiSpinBoxBatch::isSupported(const QtMultiSpinBoxEngine& engine)
+{
+    for (int i=0; i < engine.count(); i++) {
+        if (qmsbColumnType(engine.element(i)) == QtMultiSpinBoxJournalValue::Invalid)
+            return false;
+    }
+    return true;
+}
+
+QVector<QtMultiSpinBoxColumn> QtMultiSpinBoxBatch::parse(const QtMultiSpinBoxEngine& engine,
+                                                         const char* data, qint64 size,
+                                                         QVector<qint64>* errorLines)
+{
+    QMSBTRACE("QtMultiSpinBoxBatch::parse");
+    if (errorLines)
+        errorLines->clear();
+    if (!isSupported(engine)) {
+        qWarning("QtMultiSpinBoxBatch::parse: element values are not int, unsigned or double");
+        return QVector<QtMultiSpinBoxColumn>();
+    }
+
+    // chunks end after a '\n'
+    QList<QtMultiSpinBoxParseTask*> tasks;
+    const qint64 step = chunkSize();
+    const char* end = data + size;
+    for (const char* begin = data; begin < end; ) {
+        const char* chunkEnd = (end - begin > step) ? begin + step : end;
+        if (chunkEnd < end) {
+            const char* eol = static_cast<const char*>(memchr(chunkEnd, '\n', end - chunkEnd));
+            chunkEnd = eol ? eol + 1 : end;
+        }
+        tasks.append(new QtMultiSpinBoxParseTask(engine, begin, chunkEnd));
+        begin = chunkEnd;
+    }
+
+    if (tasks.count() == 1)
+        tasks.first()->run();
+    else {
+        QThreadPool pool;
+        foreach (QtMultiSpinBoxParseTask* task, tasks)
+            pool.start(task);
+        pool.waitForDone();
+    }
+
+    // concatenated in order
+    QVector<QtMultiSpinBoxColumn> columns = qmsbEmptyColumns(engine);
+    int rows = 0;
+    foreach (QtMultiSpinBoxParseTask* task, tasks)
+        rows += task->columns.isEmpty() ? 0 : task->columns.first().count();
+    for (int i=0; i < columns.count(); i++)
+        columns[i].reserve(rows);
+    qint64 firstLine = 0;
+    foreach (QtMultiSpinBoxParseTask* task, tasks) {
+        for (int i=0; i < columns.count(); i++)
+            columns[i].append(task->columns.at(i));
+        if (errorLines) {
+            foreach (qint64 line, task->errors)
+                errorLines->append(firstLine + line);
+        }
+        firstLine += task->lines;
+    }
+    qDeleteAll(tasks);
+    return columns;
+}
+
+QVector<QtMultiSpinBoxColumn> QtMultiSpinBoxBatch::parse(const QtMultiSpinBoxEngine& engine,
+                                                         const QByteArray& utf8,
+                                                         QVector<qint64>* errorLines)
+{
+    return parse(engine, utf8.constData(), utf8.size(), errorLines);
+}
+
+bool QtMultiSpinBoxBatch::parseFile(const QtMultiSpinBoxEngine& engine, const QString& fileName,
+                                    QVector<QtMultiSpinBoxColumn>& columns,
+                                    QVector<qint64>* errorLines)
+{
+    if (!isSupported(engine)) {
+        qWarning("QtMultiSpinBoxBatch::parseFile: element values are not int, unsigned or double");
+        return false;
+    }
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    if (file.size() == 0) {
+        columns = qmsbEmptyColumns(engine);
+        if (errorLines)
+            errorLines->clear();
+        return true;
+    }
+    const uchar* data = file.map(0, file.size());
+    if (data) {
+        columns = parse(engine, reinterpret_cast<const char*>(data), file.size(), errorLines);
+        file.unmap(const_cast<uchar*>(data));
+    }
+    else
+        columns = parse(engine, file.readAll(), errorLines);
+    return true;
+}
+
+QByteArray QtMultiSpinBoxBatch::format(const QtMultiSpinBoxEngine& engine,
+                                       const QVector<QtMultiSpinBoxColumn>& columns)
+{
+    QMSBTRACE("QtMultiSpinBoxBatch::format");
+    if (!isSupported(engine)) {
+        qWarning("QtMultiSpinBoxBatch::format: element values are not int, unsigned or double");
+        return QByteArray();
+    }
+    Q_ASSERT(columns.count() == engine.count());
+    const int rows = columns.isEmpty() ? 0 : columns.first().count();
+    for (int i=0; i < columns.count(); i++)
+        Q_ASSERT(columns.at(i).count() == rows);
+
+    // about 4 tasks per core
+    const int taskCount = qMax(1, qMin(rows / 1024, QThread::idealThreadCount() * 4));
+    QList<QtMultiSpinBoxFormatTask*> tasks;
+    for (int t=0; t < taskCount; t++)
+        tasks.append(new QtMultiSpinBoxFormatTask(engine, columns,
+                                                  (int)((qint64)rows * t / taskCount),
+                                                  (int)((qint64)rows * (t+1) / taskCount)));
+    if (tasks.count() == 1)
+        tasks.first()->run();
+    else {
+        QThreadPool pool;
+        foreach (QtMultiSpinBoxFormatTask* task, tasks)
+            pool.start(task);
+        pool.waitForDone();
+    }
+
+    int size = 0;
+    foreach (QtMultiSpinBoxFormatTask* task, tasks)
+        size += task->text.size();
+    QByteArray text;
+    text.reserve(size);
+    foreach (QtMultiSpinBoxFormatTask* task, tasks)
+        text += task->text;
+    qDeleteAll(tasks);
+    return text;
+}
+
+QT_END_NAMESPACE
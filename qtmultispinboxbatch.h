@@ -0,0 +1,71 @@
+#ifndef QTMULTISPINBOXBATCH_H
+#define QTMULTISPINBOXBATCH_H
+
+#include <QByteArray>
+#include <QVector>
+
+#include "qtmultispinboxengine.h"
+#include "qtmultispinboxjournal.h"
+
+
+QT_BEGIN_NAMESPACE
+
+// values of one section for all the records, typed from the element
+// default value (int, unsigned or double)
+class QtMultiSpinBoxColumn
+{
+public:
+    typedef QtMultiSpinBoxJournalValue::Type Type;
+
+    QtMultiSpinBoxColumn() : type(QtMultiSpinBoxJournalValue::Double) {}
+    explicit QtMultiSpinBoxColumn(Type type) : type(type) {}
+
+    int count() const;
+    void reserve(int size);
+    void append(const QVariant& value);
+    void append(const QtMultiSpinBoxColumn& other);
+    QVariant value(int row) const;
+
+    Type type;
+    QVector<qint64> ints;    // Int
+    QVector<quint64> uints;  // UInt
+    QVector<double> doubles; // Double
+};
+
+
+// Records in the text format of an engine layout, one per line ('\n' or
+// "\r\n", empty lines skipped), parsed into columns or formatted from them.
+// The buffer is cut in chunks at line ends, the chunks are processed on
+// a thread pool: valueFromText, textFromValue and validate of the elements
+// must be thread-safe (the memo is not used).
+class QtMultiSpinBoxBatch
+{
+public:
+    // true if the default value of every element is an int, an unsigned or
+    // a double: other layouts are rejected (no columns, empty text)
+    static bool isSupported(const QtMultiSpinBoxEngine& engine);
+
+    // rows that do not match the layout or are not Acceptable are skipped,
+    // their line numbers (from 0) are added to errorLines
+    static QVector<QtMultiSpinBoxColumn> parse(const QtMultiSpinBoxEngine& engine,
+                                               const char* data, qint64 size,
+                                               QVector<qint64>* errorLines = 0);
+    static QVector<QtMultiSpinBoxColumn> parse(const QtMultiSpinBoxEngine& engine,
+                                               const QByteArray& utf8,
+                                               QVector<qint64>* errorLines = 0);
+    // memory-mapped, false if the file can not be opened or the layout is not supported
+    static bool parseFile(const QtMultiSpinBoxEngine& engine, const QString& fileName,
+                          QVector<QtMultiSpinBoxColumn>& columns,
+                          QVector<qint64>* errorLines = 0);
+
+    // one line per row ('\n' terminated), columns of the same length
+    static QByteArray format(const QtMultiSpinBoxEngine& engine,
+                             const QVector<QtMultiSpinBoxColumn>& columns);
+
+    static int chunkSize(); // bytes parsed per task (1 MiB by default)
+    static void setChunkSize(int size);
+};
+
+QT_END_NAMESPACE
+
+#endif // QTMULTISPINBOXBATCH_H
@@ -0,0 +1,24 @@
+#include "qtmultispinboxconstraints.h"
+
+
+QT_BEGIN_NAMESPACE
+
+QtSumMultiSpinBoxConstraint::QtSumMultiSpinBoxConstraint(const QList<int>& inputs, int output, double total) :
+    QtMultiSpinBoxConstraint(inputs, QList<int>() << output),
+    m_total(total)
+{
+}
+
+QVariantList QtSumMultiSpinBoxConstraint::compute(const QVariantList& inputValues) const
+{
+    double remainder = m_total;
+    foreach (const QVariant& v, inputValues) {
+        bool ok = true;
+        remainder -= v.toDouble(&ok);
+        if (!ok)
+            return QVariantList() << QVariant();
+    }
+    return QVariantList() << QVariant(remainder);
+}
+
+QT_END_NAMESPACE
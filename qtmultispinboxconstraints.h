@@ -0,0 +1,68 @@
+#ifndef QTMULTISPINBOXCONSTRAINTS_H
+#define QTMULTISPINBOXCONSTRAINTS_H
+
+#include <QList>
+#include <QVariant>
+
+#include <functional>
+
+
+QT_BEGIN_NAMESPACE
+
+// sections recomputed from other sections of the same spin box
+// (see QtMultiSpinBox::addConstraint)
+class QtMultiSpinBoxConstraint
+{
+public:
+    QtMultiSpinBoxConstraint(const QList<int>& inputs, const QList<int>& outputs) :
+        m_inputs(inputs),
+        m_outputs(outputs)
+    {
+    }
+    virtual ~QtMultiSpinBoxConstraint() {}
+
+    const QList<int>& inputs() const { return m_inputs; }   // section indexes
+    const QList<int>& outputs() const { return m_outputs; } // section indexes
+
+    // values of inputs() -> values of outputs(), an invalid QVariant keeps the output
+    virtual QVariantList compute(const QVariantList& inputValues) const = 0;
+
+private:
+    QList<int> m_inputs;
+    QList<int> m_outputs;
+};
+
+
+class QtFunctionMultiSpinBoxConstraint : public QtMultiSpinBoxConstraint
+{
+public:
+    typedef std::function<QVariantList (const QVariantList&)> Function;
+
+    QtFunctionMultiSpinBoxConstraint(const QList<int>& inputs, const QList<int>& outputs, const Function& function) :
+        QtMultiSpinBoxConstraint(inputs, outputs),
+        m_function(function)
+    {
+    }
+
+    QVariantList compute(const QVariantList& inputValues) const { return m_function(inputValues); }
+
+private:
+    Function m_function;
+};
+
+
+// output = total - sum(inputs), e.g. percentages summing to 100
+class QtSumMultiSpinBoxConstraint : public QtMultiSpinBoxConstraint
+{
+public:
+    QtSumMultiSpinBoxConstraint(const QList<int>& inputs, int output, double total = 100.0);
+
+    QVariantList compute(const QVariantList& inputValues) const;
+
+private:
+    double m_total;
+};
+
+QT_END_NAMESPACE
+
+#endif // QTMULTISPINBOXCONSTRAINTS_H
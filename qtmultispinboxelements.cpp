@@ -2,6 +2,77 @@
 
 #include <QDebug>
 
+#include <algorithm>
+#include <cmath>
+
+
+void QtMultiSpinBoxElement::setMemoCapacity(int capacity)
+{
+    m_memoCapacity = qMax(0, capacity);
+    invalidateMemo();
+}
+
+void QtMultiSpinBoxElement::invalidateMemo() const
+{
+    m_validateMemo.clear();
+    m_formatMemo.clear();
+    m_validateNext = 0;
+    m_formatNext = 0;
+    m_generation++;
+}
+
+QValidator::State QtMultiSpinBoxElement::memoValidate(QString &text, int &pos) const
+{
+    if (m_memoCapacity <= 0)
+        return validate(text, pos);
+
+    // few entries: a linear search is enough
+    for (int i=0; i < m_validateMemo.count(); i++) {
+        const ValidateEntry& e = m_validateMemo.at(i);
+        if (e.input == text) {
+            text = e.output;
+            return e.state;
+        }
+    }
+
+    ValidateEntry entry;
+    entry.input = text;
+    entry.state = validate(text, pos);
+    entry.output = text;
+    if (m_validateMemo.count() < m_memoCapacity)
+        m_validateMemo.append(entry);
+    else {
+        m_validateMemo[m_validateNext] = entry;
+        m_validateNext = (m_validateNext + 1) % m_memoCapacity;
+    }
+    return entry.state;
+}
+
+QString QtMultiSpinBoxElement::memoTextFromValue(const QVariant &value) const
+{
+    if (m_memoCapacity <= 0)
+        return textFromValue(value);
+
+    for (int i=0; i < m_formatMemo.count(); i++) {
+        const FormatEntry& e = m_formatMemo.at(i);
+        if (e.value == value)
+            return e.text;
+    }
+
+    FormatEntry entry;
+    entry.value = value;
+    entry.text = textFromValue(value);
+    if (m_formatMemo.count() < m_memoCapacity)
+        m_formatMemo.append(entry);
+    else {
+        m_formatMemo[m_formatNext] = entry;
+        m_formatNext = (m_formatNext + 1) % m_memoCapacity;
+    }
+    return entry.text;
+}
+
+//------------------------------------------------------------------------------
+
 
 QtIntMultiSpinBoxElement::QtIntMultiSpinBoxElement(QObject * parent) :
     QtMultiSpinBoxValidatorWrapper(parent),
@@ -93,3 +164,339 @@ QVariant QtDoubleMultiSpinBoxElement::stepBy(const QVariant &value, int steps)
         return QVariant(v + (double)steps * m_stepIncr);
     return QVariant();
 }
+
+//------------------------------------------------------------------------------
+
+// ASCII -> digit value (-1: not a digit)
+static const signed char qmsbDigitValues[128] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+static const char qmsbLowerDigits[] = "0123456789abcdef";
+static const char qmsbUpperDigits[] = "0123456789ABCDEF";
+
+// enough for 64 bits in base 2
+static const int qmsbMaxDigits = 64;
+
+static inline int qmsbDigitValue(QChar c)
+{
+    ushort u = c.unicode();
+    return (u < 128) ? qmsbDigitValues[u] : -1;
+}
+
+static int qmsbDigitCount(qulonglong value, int radix)
+{
+    int digits = 1;
+    while (value >= (qulonglong)radix) {
+        value /= radix;
+        digits++;
+    }
+    return digits;
+}
+
+
+int QtRadixMultiSpinBoxElement::digitValue(QChar c, int radix)
+{
+    const int d = qmsbDigitValue(c);
+    return (d < radix) ? d : -1;
+}
+
+QtRadixMultiSpinBoxElement::QtRadixMultiSpinBoxElement(int radix, QObject* parent) :
+    QObject(parent),
+    m_radix(radix),
+    m_bottom(0),
+    m_top(Q_UINT64_C(0xFFFFFFFF)),
+    m_topDigits(0),
+    m_width(0),
+    m_zeroPadded(true),
+    m_upperCase(true),
+    m_stepIncr(1)
+{
+    Q_ASSERT(radix == 2 || radix == 8 || radix == 10 || radix == 16);
+    m_topDigits = qmsbDigitCount(m_top, m_radix);
+}
+
+QtRadixMultiSpinBoxElement::QtRadixMultiSpinBoxElement(int radix, qulonglong bottom, qulonglong top, int width, QObject* parent) :
+    QObject(parent),
+    m_radix(radix),
+    m_bottom(0),
+    m_top(0),
+    m_topDigits(0),
+    m_width(0),
+    m_zeroPadded(true),
+    m_upperCase(true),
+    m_stepIncr(1)
+{
+    Q_ASSERT(radix == 2 || radix == 8 || radix == 10 || radix == 16);
+    setRange(bottom, top);
+    setWidth(width);
+}
+
+void QtRadixMultiSpinBoxElement::setRange(qulonglong bottom, qulonglong top)
+{
+    Q_ASSERT(bottom <= top);
+    m_bottom = bottom;
+    m_top = top;
+    m_topDigits = qmsbDigitCount(m_top, m_radix);
+    invalidateMemo();
+}
+
+void QtRadixMultiSpinBoxElement::setWidth(int width)
+{
+    m_width = qBound(0, width, qmsbMaxDigits);
+    invalidateMemo();
+}
+
+bool QtRadixMultiSpinBoxElement::parse(const QChar* data, int length, qulonglong& value) const
+{
+    // each digit is checked against top, so value never overflows
+    value = 0;
+    for (int i=0; i < length; i++) {
+        int d = qmsbDigitValue(data[i]);
+        if (d < 0 || d >= m_radix)
+            return false;
+        if ((qulonglong)d > m_top || value > (m_top - d) / m_radix)
+            return false;
+        value = value * m_radix + d;
+    }
+    return true;
+}
+
+QValidator::State QtRadixMultiSpinBoxElement::validate(QString &text, int &) const
+{
+    const int length = text.length();
+    if (length == 0)
+        return QValidator::Intermediate;
+    if (length > maxDigits())
+        return QValidator::Invalid;
+
+    qulonglong v = 0;
+    if (!parse(text.constData(), length, v))
+        return QValidator::Invalid;
+    if (v < m_bottom)
+        return QValidator::Intermediate;
+    return QValidator::Acceptable;
+}
+
+void QtRadixMultiSpinBoxElement::fixup(QString &text) const
+{
+    qulonglong v = 0;
+    if (text.length() <= maxDigits() && parse(text.constData(), text.length(), v))
+        text = textFromValue(QVariant(qMax(v, m_bottom)));
+}
+
+QVariant QtRadixMultiSpinBoxElement::valueFromText(const QString &text) const
+{
+    qulonglong v = 0;
+    if (!text.isEmpty() && text.length() <= maxDigits()
+            && parse(text.constData(), text.length(), v))
+        return QVariant(v);
+    return QVariant();
+}
+
+QString QtRadixMultiSpinBoxElement::textFromValue(const QVariant &value) const
+{
+    bool ok = true;
+    qulonglong v = value.toULongLong(&ok);
+    if (!ok)
+        return QString();
+
+    const char* digits = m_upperCase ? qmsbUpperDigits : qmsbLowerDigits;
+    QChar buffer[qmsbMaxDigits];
+    int start = qmsbMaxDigits;
+    do {
+        buffer[--start] = QLatin1Char(digits[v % m_radix]);
+        v /= m_radix;
+    } while (v != 0);
+    if (m_zeroPadded) {
+        while (qmsbMaxDigits - start < m_width)
+            buffer[--start] = QLatin1Char('0');
+    }
+    return QString(buffer + start, qmsbMaxDigits - start);
+}
+
+QVariant QtRadixMultiSpinBoxElement::stepBy(const QVariant &value, int steps)
+{
+    bool ok = true;
+    qulonglong v = value.toULongLong(&ok);
+    if (!ok)
+        return QVariant();
+
+    v = qBound(m_bottom, v, m_top);
+    qulonglong distance = (steps < 0) ? (qulonglong)(-(qlonglong)steps) : (qulonglong)steps;
+    // saturate instead of overflowing
+    if (m_stepIncr != 0 && distance > (m_top - m_bottom) / m_stepIncr)
+        return QVariant(steps < 0 ? m_bottom : m_top);
+    distance *= m_stepIncr;
+    if (steps >= 0)
+        v = (m_top - v < distance) ? m_top : v + distance;
+    else
+        v = (v - m_bottom < distance) ? m_bottom : v - distance;
+    return QVariant(v);
+}
+
+//------------------------------------------------------------------------------
+
+QtDiscreteMultiSpinBoxElement::QtDiscreteMultiSpinBoxElement(QObject* parent) :
+    QObject(parent),
+    m_decimals(0),
+    m_tolerance(0.5)
+{
+}
+
+QtDiscreteMultiSpinBoxElement::QtDiscreteMultiSpinBoxElement(const QVector<double>& values, int decimals, QObject* parent) :
+    QObject(parent),
+    m_decimals(0),
+    m_tolerance(0.5)
+{
+    setDecimals(decimals);
+    setValues(values);
+}
+
+void QtDiscreteMultiSpinBoxElement::setValues(const QVector<double>& values)
+{
+    m_values = values;
+    std::sort(m_values.begin(), m_values.end());
+    m_values.erase(std::unique(m_values.begin(), m_values.end()), m_values.end());
+    invalidateMemo();
+}
+
+void QtDiscreteMultiSpinBoxElement::setDecimals(int decimals)
+{
+    m_decimals = qBound(0, decimals, 15);
+    m_tolerance = 0.5 * std::pow(10.0, -m_decimals);
+    invalidateMemo();
+}
+
+int QtDiscreteMultiSpinBoxElement::lowerBound(double value) const
+{
+    return std::lower_bound(m_values.constBegin(), m_values.constEnd(), value - m_tolerance) - m_values.constBegin();
+}
+
+int QtDiscreteMultiSpinBoxElement::indexOf(double value) const
+{
+    int i = lowerBound(value);
+    if (i < m_values.count() && qAbs(m_values.at(i) - value) <= m_tolerance)
+        return i;
+    return -1;
+}
+
+double QtDiscreteMultiSpinBoxElement::nearest(double value) const
+{
+    if (m_values.isEmpty())
+        return value;
+    int i = std::lower_bound(m_values.constBegin(), m_values.constEnd(), value) - m_values.constBegin();
+    if (i == m_values.count())
+        return m_values.last();
+    if (i > 0 && value - m_values.at(i-1) <= m_values.at(i) - value)
+        return m_values.at(i-1);
+    return m_values.at(i);
+}
+
+bool QtDiscreteMultiSpinBoxElement::parse(const QString& text, double& value, bool& complete) const
+{
+    // [-]digits[(.|,)digits], both separators accepted like the double element
+    const QChar* c = text.constData();
+    const QChar* end = c + text.length();
+    bool negative = false;
+    if (c != end && *c == QLatin1Char('-')) {
+        negative = true;
+        ++c;
+    }
+    double v = 0;
+    int digits = 0;
+    int fraction = -1; // digits after the separator
+    double scale = 1;
+    for (; c != end; ++c) {
+        const ushort u = c->unicode();
+        if (u >= '0' && u <= '9') {
+            if (fraction >= 0) {
+                if (++fraction > m_decimals)
+                    return false;
+                scale /= 10;
+                v += (u - '0') * scale;
+            }
+            else
+                v = v * 10 + (u - '0');
+            digits++;
+        }
+        else if ((u == '.' || u == ',') && fraction < 0 && m_decimals > 0)
+            fraction = 0;
+        else
+            return false;
+    }
+    value = negative ? -v : v;
+    complete = (digits > 0 && fraction != 0);
+    return true;
+}
+
+QValidator::State QtDiscreteMultiSpinBoxElement::validate(QString &text, int &) const
+{
+    double v = 0;
+    bool complete = false;
+    if (!parse(text, v, complete))
+        return QValidator::Invalid;
+    if (!complete || m_values.isEmpty())
+        return QValidator::Intermediate;
+    // more digits only move away from zero
+    if ((v >= 0 && v > m_values.last() + m_tolerance) || (v < 0 && v < m_values.first() - m_tolerance))
+        return QValidator::Invalid;
+    return (indexOf(v) >= 0) ? QValidator::Acceptable : QValidator::Intermediate;
+}
+
+void QtDiscreteMultiSpinBoxElement::fixup(QString &text) const
+{
+    double v = 0;
+    bool complete = false;
+    if (m_values.isEmpty() || !parse(text, v, complete))
+        return;
+    Q_UNUSED(complete);
+    text = textFromValue(QVariant(nearest(v)));
+}
+
+QVariant QtDiscreteMultiSpinBoxElement::defaultValue() const
+{
+    return QVariant(m_values.isEmpty() ? 0.0 : m_values.first());
+}
+
+QVariant QtDiscreteMultiSpinBoxElement::valueFromText(const QString &text) const
+{
+    double v = 0;
+    bool complete = false;
+    if (parse(text, v, complete) && complete)
+        return QVariant(v);
+    return QVariant();
+}
+
+QString QtDiscreteMultiSpinBoxElement::textFromValue(const QVariant &value) const
+{
+    bool ok = true;
+    double v = value.toDouble(&ok);
+    if (!ok)
+        return QString();
+    return QString::number(v, 'f', m_decimals);
+}
+
+QVariant QtDiscreteMultiSpinBoxElement::stepBy(const QVariant &value, int steps)
+{
+    bool ok = true;
+    double v = value.toDouble(&ok);
+    if (!ok || m_values.isEmpty())
+        return QVariant();
+
+    // from between two values, the first step lands on the neighbour
+    const int n = m_values.count();
+    int i = lowerBound(v);
+    bool exact = (i < n && qAbs(m_values.at(i) - v) <= m_tolerance);
+    qint64 target = (qint64)i + steps;
+    if (steps > 0 && !exact)
+        target--;
+    return QVariant(m_values.at((int)qBound<qint64>(0, target, n - 1)));
+}
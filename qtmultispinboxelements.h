@@ -6,12 +6,14 @@
 #include <QValidator>
 
 #include <QIntValidator>
+#include <QObject>
+#include <QVector>
 
 
 class QtMultiSpinBoxElement
 {
 public:
-    explicit QtMultiSpinBoxElement() {}
+    explicit QtMultiSpinBoxElement() : m_memoCapacity(0), m_validateNext(0), m_formatNext(0), m_generation(0) {}
     virtual ~QtMultiSpinBoxElement() {}
 
     virtual QVariant defaultValue() const = 0;
@@ -21,6 +23,47 @@ public:
 
     virtual QValidator::State validate(QString &, int &) const = 0;
     virtual void fixup(QString &) const {}
+
+    // expensive check (dictionary, database...) run on a thread pool after
+    // validate(), which stays cheap: Intermediate for an incomplete section,
+    // Acceptable when only validateAsync() can decide. Asked only for the
+    // sections validate() accepts, the section state is the lowest of the
+    // two. Called from worker threads: must be thread-safe. Taking, removing or clearing the elements and destroying
+    // the spin box drop their queued checks and wait for the running ones
+    virtual bool hasAsyncValidation() const { return false; }
+    virtual QValidator::State validateAsync(const QString &) const { return QValidator::Acceptable; }
+
+    // opt-in memo of the last validate() and textFromValue() results (used by
+    // the spin box), 0: disabled. validate() must not depend on the cursor.
+    // Call invalidateMemo() when the configuration changes (range, decimals...)
+    void setMemoCapacity(int capacity);
+    int memoCapacity() const { return m_memoCapacity; }
+    void invalidateMemo() const;
+    // incremented by invalidateMemo(): sections validated before are checked again
+    int generation() const { return m_generation; }
+
+    QValidator::State memoValidate(QString &text, int &pos) const;
+    QString memoTextFromValue(const QVariant &value) const;
+
+private:
+    struct ValidateEntry
+    {
+        QString input;
+        QString output;
+        QValidator::State state;
+    };
+    struct FormatEntry
+    {
+        QVariant value;
+        QString text;
+    };
+
+    int m_memoCapacity;
+    mutable QVector<ValidateEntry> m_validateMemo;
+    mutable int m_validateNext;
+    mutable QVector<FormatEntry> m_formatMemo;
+    mutable int m_formatNext;
+    mutable int m_generation;
 };
 
 
@@ -31,7 +74,11 @@ class QtMultiSpinBoxValidatorWrapper :
         public QtMultiSpinBoxElement
 {
 public:
-    explicit QtMultiSpinBoxValidatorWrapper(QObject * parent = 0) : V(parent) {}
+    explicit QtMultiSpinBoxValidatorWrapper(QObject * parent = 0) : V(parent)
+    {
+        // range, decimals, locale... changed: memoized results are obsolete
+        QObject::connect(this, &QValidator::changed, [this]() { this->invalidateMemo(); });
+    }
 
     QValidator::State validate(QString &text, int &pos) const { return V::validate(text, pos); }
     void fixup(QString &text) const { V::fixup(text); }
@@ -56,7 +103,7 @@ public:
     QString textFromValue(const QVariant &value) const;
     QVariant stepBy(const QVariant &value, int steps);
 
-    void setStepIncrement(int incr) { m_stepIncr = incr; }
+    void setStepIncrement(int incr) { m_stepIncr = incr; invalidateMemo(); }
     int stepIncrement() const { return m_stepIncr; }
 
 private:
@@ -68,7 +115,7 @@ class QtDoubleMultiSpinBoxElement :
         public QtMultiSpinBoxValidatorWrapper<QDoubleValidator>
 {
     Q_OBJECT
-    Q_PROPERTY(int stepIncrement READ stepIncrement WRITE setStepIncrement)
+    Q_PROPERTY(double stepIncrement READ stepIncrement WRITE setStepIncrement)
 
 public:
     explicit QtDoubleMultiSpinBoxElement(QObject* parent = 0);
@@ -79,7 +126,7 @@ public:
     QString textFromValue(const QVariant &value) const;
     QVariant stepBy(const QVariant &value, int steps);
 
-    void setStepIncrement(double incr) { m_stepIncr = incr; }
+    void setStepIncrement(double incr) { m_stepIncr = incr; invalidateMemo(); }
     double stepIncrement() const { return m_stepIncr; }
 
 private:
@@ -87,4 +134,121 @@ private:
 };
 
 
+//------------------------------------------------------------------------------
+
+
+// unsigned integer in base 2, 8, 10 or 16 (registers, octets, ...)
+// validate/format/step use lookup tables and never allocate (except the
+// returned string of textFromValue)
+class QtRadixMultiSpinBoxElement :
+        public QObject,
+        public QtMultiSpinBoxElement
+{
+    Q_OBJECT
+    Q_PROPERTY(int radix READ radix)
+    Q_PROPERTY(int width READ width WRITE setWidth)
+    Q_PROPERTY(bool zeroPadded READ isZeroPadded WRITE setZeroPadded)
+    Q_PROPERTY(bool upperCase READ isUpperCase WRITE setUpperCase)
+    Q_PROPERTY(qulonglong bottom READ bottom)
+    Q_PROPERTY(qulonglong top READ top)
+    Q_PROPERTY(qulonglong stepIncrement READ stepIncrement WRITE setStepIncrement)
+
+public:
+    explicit QtRadixMultiSpinBoxElement(int radix = 16, QObject* parent = 0);
+    QtRadixMultiSpinBoxElement(int radix, qulonglong bottom, qulonglong top, int width = 0, QObject* parent = 0);
+
+    QVariant defaultValue() const { return QVariant(m_bottom); }
+    QVariant valueFromText(const QString &text) const;
+    QString textFromValue(const QVariant &value) const;
+    QVariant stepBy(const QVariant &value, int steps);
+
+    QValidator::State validate(QString &text, int &pos) const;
+    void fixup(QString &text) const;
+
+    int radix() const { return m_radix; }
+    // value of an ASCII digit in radix, -1 if not a digit of it
+    static int digitValue(QChar c, int radix);
+
+    void setRange(qulonglong bottom, qulonglong top);
+    qulonglong bottom() const { return m_bottom; }
+    qulonglong top() const { return m_top; }
+
+    // minimal count of digits, padded with '0' if zeroPadded (0: no padding)
+    void setWidth(int width);
+    int width() const { return m_width; }
+
+    void setZeroPadded(bool padded) { m_zeroPadded = padded; invalidateMemo(); }
+    bool isZeroPadded() const { return m_zeroPadded; }
+
+    void setUpperCase(bool upper) { m_upperCase = upper; invalidateMemo(); }
+    bool isUpperCase() const { return m_upperCase; }
+
+    void setStepIncrement(qulonglong incr) { m_stepIncr = incr; invalidateMemo(); }
+    qulonglong stepIncrement() const { return m_stepIncr; }
+
+private:
+    // return false if text is not a number in this radix or above top
+    bool parse(const QChar* data, int length, qulonglong& value) const;
+    int maxDigits() const { return qMax(m_width, m_topDigits); }
+
+private:
+    int m_radix;
+    qulonglong m_bottom;
+    qulonglong m_top;
+    int m_topDigits;
+    int m_width;
+    bool m_zeroPadded;
+    bool m_upperCase;
+    qulonglong m_stepIncr;
+};
+
+
+//------------------------------------------------------------------------------
+
+
+// one of a sorted set of allowed values (channel frequencies, preset gains...)
+// validate, snap (fixup) and step use binary searches, never a linear scan
+class QtDiscreteMultiSpinBoxElement :
+        public QObject,
+        public QtMultiSpinBoxElement
+{
+    Q_OBJECT
+    Q_PROPERTY(int decimals READ decimals WRITE setDecimals)
+    Q_PROPERTY(int count READ count)
+
+public:
+    explicit QtDiscreteMultiSpinBoxElement(QObject* parent = 0);
+    QtDiscreteMultiSpinBoxElement(const QVector<double>& values, int decimals = 0, QObject* parent = 0);
+
+    QVariant defaultValue() const;
+    QVariant valueFromText(const QString &text) const;
+    QString textFromValue(const QVariant &value) const;
+    QVariant stepBy(const QVariant &value, int steps); // to the next allowed values
+
+    QValidator::State validate(QString &text, int &pos) const; // Intermediate if not allowed
+    void fixup(QString &text) const;                           // snap to the nearest
+
+    // sorted and deduplicated here
+    void setValues(const QVector<double>& values);
+    const QVector<double>& values() const { return m_values; }
+    int count() const { return m_values.count(); }
+
+    int indexOf(double value) const; // -1 if not allowed
+    double nearest(double value) const;
+
+    void setDecimals(int decimals);
+    int decimals() const { return m_decimals; }
+
+private:
+    // false if text is not a number with at most decimals digits after the point
+    bool parse(const QString& text, double& value, bool& complete) const;
+    int lowerBound(double value) const; // first index with values[index] >= value - tolerance
+
+private:
+    QVector<double> m_values;
+    int m_decimals;
+    double m_tolerance; // half of the last displayed digit
+};
+
+
 #endif // QTMULTISPINBOXELEMENTS_H
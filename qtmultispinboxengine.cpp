@@ -0,0 +1,288 @@
+#include "qtmultispinboxengine.h"
+
+#include "qtmultispinboxelements.h"
+#include "qtmultispinboxtrace.h"
+
+
+QT_BEGIN_NAMESPACE
+
+QtMultiSpinBoxData::QtMultiSpinBoxData(QtMultiSpinBoxElement* element,
+                                       const QString& suffix) :
+    element(element),
+    suffix(suffix)
+{
+}
+
+//==============================================================================
+
+
+QtMultiSpinBoxEngine::QtMultiSpinBoxEngine()
+{
+}
+
+QtMultiSpinBoxEngine::~QtMultiSpinBoxEngine()
+{
+    qDeleteAll(m_datas);
+}
+
+void QtMultiSpinBoxEngine::clear()
+{
+    m_prefix.resize(0);
+    qDeleteAll(m_datas);
+    m_datas.clear();
+}
+
+void QtMultiSpinBoxEngine::insertElement(int index, QtMultiSpinBoxElement* element, const QString &suffix)
+{
+    Q_ASSERT(index >= 0 && index <= count());
+    Q_ASSERT(element != NULL);
+    m_datas.insert(index, new QtMultiSpinBoxData(element, simplify(suffix)));
+}
+
+QtMultiSpinBoxElement* QtMultiSpinBoxEngine::takeElement(int index)
+{
+    Q_ASSERT(index >= 0 && index < count());
+    QtMultiSpinBoxData* data = m_datas.takeAt(index);
+    QtMultiSpinBoxElement* element = data->element;
+    delete data;
+    return element;
+}
+
+void QtMultiSpinBoxEngine::setPrefix(const QString& prefix)
+{
+    m_prefix = prefix.simplified();
+}
+
+void QtMultiSpinBoxEngine::setSuffix(int index, const QString& suffix)
+{
+    Q_ASSERT(index >= 0 && index < count());
+    m_datas.at(index)->suffix = simplify(suffix);
+}
+
+
+QString QtMultiSpinBoxEngine::simplify(const QString& text)
+{
+    const QChar blank = QLatin1Char(' ');
+    if (text.isEmpty())
+        return text;
+    QString s = text.simplified();
+    bool wasEmpty = s.isEmpty();
+    // re-add first whitespaces
+    for (int index=0; index < text.length() && text.at(index).isSpace(); index++)
+        s.insert(index, blank);
+    if (!wasEmpty) {
+        // re-add last whitespaces
+        for (int index = 0; index < text.length() && text.at(text.length() - index-1).isSpace(); index++)
+            s.insert(s.length() - index, blank);
+    }
+    return s;
+}
+
+
+//-----------------------------------------------------------------------------
+// parsing
+
+
+bool QtMultiSpinBoxEngine::checkAndSplit(const QString& input, QList<QStringRef>& result) const
+{
+    QMSBTRACE("checkAndSplit");
+    QStringRef r = QStringRef(&input);
+    if (!m_prefix.isEmpty()) {
+        if (!r.startsWith(m_prefix, Qt::CaseSensitive))
+            return false;
+        r = r.mid(m_prefix.length());
+    }
+    QList<QtMultiSpinBoxData*>::const_iterator it;
+    for (it = m_datas.constBegin(); it != m_datas.constEnd(); ++it) {
+        if (!(*it)->suffix.isEmpty()) {
+            int index = r.indexOf((*it)->suffix, 0, Qt::CaseSensitive);
+            if (index < 0)
+                break;
+            result.append(r.mid(0, index));
+            r = r.mid(index + (*it)->suffix.length());
+        }
+        else {
+            // this should be the last one
+            result.append(r);
+            r.clear();
+            ++it;
+            break;
+        }
+    }
+    return (it == m_datas.constEnd() && r.length() == 0);
+}
+
+int QtMultiSpinBoxEngine::textIndex(const QString& text, int indexElement) const
+{
+    int index = 0;
+    if (!m_prefix.isEmpty()) {
+        if (!text.startsWith(m_prefix, Qt::CaseSensitive))
+            return -1;
+        else
+            index += m_prefix.length();
+    }
+    Q_ASSERT(indexElement <= m_datas.count());
+    for (int i=0; i<indexElement && index >= 0; i++) {
+        QtMultiSpinBoxData* e = m_datas.value(i);
+        if (!e->suffix.isEmpty()) {
+            index = text.indexOf(e->suffix, index, Qt::CaseSensitive);
+            if (index >= 0)
+                index += e->suffix.length();
+        }
+        else {
+            // this must be the last one
+            if (i+1 == indexElement && indexElement == m_datas.count())
+                index = text.length();
+            else
+                index = -1;
+            break;
+        }
+    }
+    return index;
+}
+
+QValidator::State QtMultiSpinBoxEngine::validate(QString &text) const
+{
+    QList<QStringRef> splits;
+    if (!checkAndSplit(text, splits))
+        return QValidator::Invalid;
+
+    QValidator::State result = QValidator::Acceptable;
+    QStringList texts;
+    bool changed = false;
+    for (int i=0; i < splits.count(); i++) {
+        QString sectionText = splits.at(i).toString();
+        int pos = 0;
+        QValidator::State state = element(i)->validate(sectionText, pos);
+        if (state == QValidator::Invalid)
+            return QValidator::Invalid;
+        if (state == QValidator::Intermediate)
+            result = QValidator::Intermediate;
+        changed = changed || (splits.at(i) != sectionText);
+        texts.append(sectionText);
+    }
+    if (changed)
+        text = setTextsAt(text, 0, texts);
+    return result;
+}
+
+QVariantList QtMultiSpinBoxEngine::values(const QString &text, bool* ok) const
+{
+    QVariantList result;
+    QList<QStringRef> splits;
+    bool matched = checkAndSplit(text, splits);
+    if (ok)
+        *ok = matched;
+    if (!matched)
+        return result;
+    result.reserve(splits.count());
+    for (int i=0; i < splits.count(); i++) {
+        QVariant v = element(i)->valueFromText(splits.at(i).toString());
+        if (ok && !v.isValid())
+            *ok = false;
+        result.append(v);
+    }
+    return result;
+}
+
+
+//-----------------------------------------------------------------------------
+// formatting
+
+
+QString QtMultiSpinBoxEngine::text(const QVariantList& values) const
+{
+    QString result = m_prefix;
+    for (int i=0; i < m_datas.count(); i++) {
+        QtMultiSpinBoxElement* e = element(i);
+        QString sectionText;
+        if (i < values.count() && values.at(i).isValid())
+            sectionText = e->memoTextFromValue(values.at(i));
+        if (sectionText.isNull())
+            sectionText = e->memoTextFromValue(e->defaultValue()).simplified();
+        result += sectionText;
+        result += suffix(i);
+    }
+    return result;
+}
+
+QString QtMultiSpinBoxEngine::textAt(const QString& input, int index) const
+{
+    QList<QStringRef> splits;
+    bool ok = checkAndSplit(input, splits);
+    Q_ASSERT(ok);
+    Q_UNUSED(ok);
+    Q_ASSERT(index >= 0 && index < splits.count());
+    return splits.value(index).toString();
+}
+
+QString QtMultiSpinBoxEngine::setTextAt(const QString& input, int index, const QString &text) const
+{
+    QList<QStringRef> splits;
+    bool ok = checkAndSplit(input, splits);
+    Q_ASSERT(ok);
+    Q_UNUSED(ok);
+    Q_ASSERT(index >= 0 && index < splits.count());
+    QStringRef r = splits.value(index);
+    return QString(input).replace(r.position(), r.length(), text);
+}
+
+QString QtMultiSpinBoxEngine::setTextsAt(const QString& input, int index, const QStringList &texts) const
+{
+    QList<QStringRef> splits;
+    bool ok = checkAndSplit(input, splits);
+    Q_ASSERT(ok);
+    Q_UNUSED(ok);
+    Q_ASSERT(index >= 0 && index + texts.count() <= splits.count());
+
+    QString result;
+    result.reserve(input.length());
+    result += m_prefix;
+    for (int i=0; i < m_datas.count(); i++) {
+        if (i >= index && i < index + texts.count())
+            result += texts.at(i - index);
+        else
+            result += splits.at(i);
+        result += m_datas.at(i)->suffix;
+    }
+    return result;
+}
+
+static inline bool qIsPasteDelimiter(QChar c)
+{
+    switch (c.unicode()) {
+    case ';': case '|':
+    case '(': case ')': case '[': case ']': case '{': case '}':
+        return true;
+    default:
+        return c.isSpace();
+    }
+}
+
+void QtMultiSpinBoxEngine::tokenize(const QString& input, bool splitOnComma, QList<QStringRef>& tokens)
+{
+    tokens.clear();
+    const int length = input.length();
+    int start = -1;
+    for (int i=0; i <= length; i++) {
+        bool delimiter = (i == length);
+        if (!delimiter) {
+            QChar c = input.at(i);
+            if (c == QLatin1Char(','))
+                delimiter = splitOnComma
+                        || i == 0 || qIsPasteDelimiter(input.at(i-1))
+                        || i+1 == length || qIsPasteDelimiter(input.at(i+1));
+            else
+                delimiter = qIsPasteDelimiter(c);
+        }
+        if (delimiter) {
+            if (start >= 0)
+                tokens.append(input.midRef(start, i - start));
+            start = -1;
+        }
+        else if (start < 0)
+            start = i;
+    }
+}
+
+QT_END_NAMESPACE
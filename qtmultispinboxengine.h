@@ -0,0 +1,82 @@
+#ifndef QTMULTISPINBOXENGINE_H
+#define QTMULTISPINBOXENGINE_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QStringRef>
+#include <QValidator>
+#include <QVariant>
+
+
+QT_BEGIN_NAMESPACE
+
+class QtMultiSpinBoxElement;
+
+
+class QtMultiSpinBoxData
+{
+public:
+    QtMultiSpinBoxData(QtMultiSpinBoxElement* element, const QString &suffix);
+
+    QtMultiSpinBoxElement* element;
+    QString suffix;
+};
+
+
+// Layout of a multi spin box text, "<prefix>s0<suffix0>s1<suffix1>...",
+// and its parsing/formatting, without any widget: QtMultiSpinBox uses it,
+// and it can parse or format the same texts in a service (QtCore + QtGui
+// for QValidator only). The elements are not owned.
+class QtMultiSpinBoxEngine
+{
+public:
+    QtMultiSpinBoxEngine();
+    ~QtMultiSpinBoxEngine();
+
+    void clear(); // prefix and elements
+
+    // same rules than QtMultiSpinBox: only the last suffix can be empty,
+    // whitespaces are simplified
+    void insertElement(int index, QtMultiSpinBoxElement* element, const QString &suffix = QString());
+    void appendElement(QtMultiSpinBoxElement* element, const QString &suffix = QString()) { insertElement(count(), element, suffix); }
+    QtMultiSpinBoxElement* takeElement(int index);
+
+    int count() const { return m_datas.count(); }
+    QtMultiSpinBoxElement* element(int index) const { return m_datas.at(index)->element; }
+    QtMultiSpinBoxData* data(int index) const { return m_datas.value(index); }
+
+    const QString& prefix() const { return m_prefix; }
+    void setPrefix(const QString& prefix); // simplified
+    const QString& suffix(int index) const { return m_datas.at(index)->suffix; }
+    void setSuffix(int index, const QString& suffix);
+
+    // simplify whitespace but do not trimmed
+    static QString simplify(const QString& text);
+
+
+    // parsing
+    int textIndex(const QString &text, int indexElement) const; // -1 if the text does not match
+    bool checkAndSplit(const QString &input, QList<QStringRef> &result) const; // chunk of text (no prefix no suffix)
+    QValidator::State validate(QString &text) const; // every section
+    QVariantList values(const QString &text, bool* ok = 0) const;
+
+    // formatting, missing or invalid values are the default values
+    QString text(const QVariantList& values = QVariantList()) const;
+    QString textAt(const QString& input, int index) const;
+    QString setTextAt(const QString& input, int index, const QString &text) const;
+    QString setTextsAt(const QString& input, int index, const QStringList &texts) const; // one pass
+
+    // values of a pasted text, ',' splits only if splitOnComma or next to a delimiter
+    static void tokenize(const QString& input, bool splitOnComma, QList<QStringRef>& tokens);
+
+private:
+    Q_DISABLE_COPY(QtMultiSpinBoxEngine)
+
+    QString m_prefix;
+    QList<QtMultiSpinBoxData*> m_datas;
+};
+
+QT_END_NAMESPACE
+
+#endif // QTMULTISPINBOXENGINE_H
@@ -0,0 +1,127 @@
+#include "qtmultispinboxgroup.h"
+
+#include <QMetaProperty>
+
+#include "qtmultispinbox.h"
+#include "qtmultispinboxelements.h"
+
+
+QT_BEGIN_NAMESPACE
+
+//==============================================================================
+
+QtMultiSpinBoxGroup::QtMultiSpinBoxGroup(QObject* parent) :
+    QObject(parent)
+{
+}
+
+void QtMultiSpinBoxGroup::addSpinBox(QtMultiSpinBox* spinBox)
+{
+    if (!spinBox || m_spinBoxes.contains(spinBox))
+        return;
+    m_spinBoxes.append(spinBox);
+    connect(spinBox, SIGNAL(destroyed(QObject*)),
+            this, SLOT(spinBoxDestroyed(QObject*)));
+}
+
+void QtMultiSpinBoxGroup::addSpinBoxes(QWidget* parent)
+{
+    if (!parent)
+        return;
+    foreach (QtMultiSpinBox* spinBox, parent->findChildren<QtMultiSpinBox*>())
+        addSpinBox(spinBox);
+}
+
+void QtMultiSpinBoxGroup::removeSpinBox(QtMultiSpinBox* spinBox)
+{
+    if (m_spinBoxes.removeAll(spinBox) > 0)
+        disconnect(spinBox, 0, this, 0);
+}
+
+void QtMultiSpinBoxGroup::clear()
+{
+    foreach (QtMultiSpinBox* spinBox, spinBoxes())
+        disconnect(spinBox, 0, this, 0);
+    m_spinBoxes.clear();
+}
+
+int QtMultiSpinBoxGroup::count() const
+{
+    return spinBoxes().count();
+}
+
+QList<QtMultiSpinBox*> QtMultiSpinBoxGroup::spinBoxes() const
+{
+    QList<QtMultiSpinBox*> result;
+    result.reserve(m_spinBoxes.count());
+    foreach (const QPointer<QtMultiSpinBox>& spinBox, m_spinBoxes) {
+        if (spinBox)
+            result.append(spinBox);
+    }
+    return result;
+}
+
+void QtMultiSpinBoxGroup::spinBoxDestroyed(QObject* object)
+{
+    for (int i=m_spinBoxes.count()-1; i >= 0; i--) {
+        QObject* spinBox = m_spinBoxes.at(i).data();
+        if (!spinBox || spinBox == object)
+            m_spinBoxes.removeAt(i);
+    }
+}
+
+//------------------------------------------------------------------------------
+// batch setters
+
+
+void QtMultiSpinBoxGroup::apply(const std::function<void (QtMultiSpinBox*)>& function)
+{
+    foreach (QtMultiSpinBox* spinBox, spinBoxes())
+        function(spinBox);
+}
+
+void QtMultiSpinBoxGroup::setEnabled(bool enabled)
+{
+    apply([enabled](QtMultiSpinBox* spinBox) {
+        // explicitly disabled, whatever its parents
+        if (spinBox->testAttribute(Qt::WA_ForceDisabled) == enabled)
+            spinBox->setEnabled(enabled);
+    });
+}
+
+void QtMultiSpinBoxGroup::setAlignment(Qt::Alignment alignment)
+{
+    apply([alignment](QtMultiSpinBox* spinBox) {
+        if (spinBox->alignment() != alignment)
+            spinBox->setAlignment(alignment);
+    });
+}
+
+void QtMultiSpinBoxGroup::setCurrentSectionIndex(int index)
+{
+    apply([index](QtMultiSpinBox* spinBox) {
+        spinBox->setCurrentSectionIndex(index);
+    });
+}
+
+void QtMultiSpinBoxGroup::setStepIncrement(const QVariant& increment, int section)
+{
+    apply([&increment, section](QtMultiSpinBox* spinBox) {
+        const int first = section < 0 ? 0 : section;
+        const int last = section < 0 ? spinBox->count() - 1 : qMin(section, spinBox->count() - 1);
+        for (int i=first; i <= last; i++) {
+            QObject* object = dynamic_cast<QObject*>(spinBox->getSpinElement(i));
+            if (object && object->metaObject()->indexOfProperty("stepIncrement") >= 0)
+                object->setProperty("stepIncrement", increment);
+        }
+    });
+}
+
+void QtMultiSpinBoxGroup::setValues(const QVariantList& values)
+{
+    apply([&values](QtMultiSpinBox* spinBox) {
+        spinBox->setValues(values);
+    });
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,54 @@
+#ifndef QTMULTISPINBOXGROUP_H
+#define QTMULTISPINBOXGROUP_H
+
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QVariant>
+
+#include <functional>
+
+
+QT_BEGIN_NAMESPACE
+
+class QtMultiSpinBox;
+class QWidget;
+
+// spin boxes registered once and updated together: the setters leave
+// unchanged values alone, so only the spin boxes that change are repainted
+// (Qt merges their updates in one paint per event loop pass)
+class QtMultiSpinBoxGroup : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit QtMultiSpinBoxGroup(QObject* parent = 0);
+
+    void addSpinBox(QtMultiSpinBox* spinBox);
+    void addSpinBoxes(QWidget* parent); // every QtMultiSpinBox child of parent
+    void removeSpinBox(QtMultiSpinBox* spinBox);
+    void clear();
+
+    int count() const;
+    QList<QtMultiSpinBox*> spinBoxes() const;
+
+    void apply(const std::function<void (QtMultiSpinBox*)>& function);
+
+    void setEnabled(bool enabled);
+    void setAlignment(Qt::Alignment alignment);
+    void setCurrentSectionIndex(int index);
+    // "stepIncrement" of the elements that have one, section -1 for all
+    void setStepIncrement(const QVariant& increment, int section = -1);
+    // same values for all, the sections of spin boxes with another layout are left as is
+    void setValues(const QVariantList& values);
+
+private Q_SLOTS:
+    void spinBoxDestroyed(QObject* object);
+
+private:
+    QList<QPointer<QtMultiSpinBox> > m_spinBoxes;
+};
+
+QT_END_NAMESPACE
+
+#endif // QTMULTISPINBOXGROUP_H
@@ -0,0 +1,117 @@
+#include "qtmultispinboxjournal.h"
+
+#include <QMutexLocker>
+
+
+QT_BEGIN_NAMESPACE
+
+QtMultiSpinBoxJournalValue QtMultiSpinBoxJournalValue::fromVariant(const QVariant& value)
+{
+    QtMultiSpinBoxJournalValue v;
+    switch ((int)value.type()) {
+    case QMetaType::Int:
+    case QMetaType::LongLong:
+        v.type = Int;
+        v.data.i = value.toLongLong();
+        break;
+    case QMetaType::UInt:
+    case QMetaType::ULongLong:
+        v.type = UInt;
+        v.data.u = value.toULongLong();
+        break;
+    case QMetaType::Double:
+    case QMetaType::Float:
+        v.type = Double;
+        v.data.d = value.toDouble();
+        break;
+    default:
+        break;
+    }
+    return v;
+}
+
+QVariant QtMultiSpinBoxJournalValue::toVariant() const
+{
+    switch (type) {
+    case Int:
+        return QVariant(data.i);
+    case UInt:
+        return QVariant(data.u);
+    case Double:
+        return QVariant(data.d);
+    default:
+        return QVariant();
+    }
+}
+
+bool QtMultiSpinBoxJournalValue::operator==(const QtMultiSpinBoxJournalValue& other) const
+{
+    if (type != other.type)
+        return false;
+    switch (type) {
+    case Int:
+        return data.i == other.data.i;
+    case UInt:
+        return data.u == other.data.u;
+    case Double:
+        return data.d == other.data.d;
+    default:
+        return true;
+    }
+}
+
+
+//==============================================================================
+
+
+QtMultiSpinBoxJournal::QtMultiSpinBoxJournal(int capacity) :
+    m_records(qMax(1, capacity))
+{
+}
+
+int QtMultiSpinBoxJournal::count() const
+{
+    // counters wrap around: unsigned difference
+    return (int)((uint)m_head.loadAcquire() - (uint)m_tail.loadAcquire());
+}
+
+int QtMultiSpinBoxJournal::dropped() const
+{
+    return m_dropped.loadAcquire();
+}
+
+bool QtMultiSpinBoxJournal::append(const QtMultiSpinBoxChange& change)
+{
+    const uint head = (uint)m_head.loadAcquire();
+    if (head - (uint)m_tail.loadAcquire() >= (uint)m_records.count()) {
+        m_dropped.fetchAndAddRelaxed(1);
+        return false;
+    }
+    // the slot is not read until the head is published
+    m_records.data()[head % (uint)m_records.count()] = change;
+    m_head.storeRelease((int)(head + 1));
+    return true;
+}
+
+int QtMultiSpinBoxJournal::drain(QtMultiSpinBoxChange* changes, int maxCount)
+{
+    QMutexLocker locker(&m_drainMutex);
+    const uint tail = (uint)m_tail.loadAcquire();
+    const uint available = (uint)m_head.loadAcquire() - tail;
+    const int n = (int)qMin(available, (uint)qMax(0, maxCount));
+    const QtMultiSpinBoxChange* records = m_records.constData();
+    for (int i=0; i < n; i++)
+        changes[i] = records[(tail + i) % (uint)m_records.count()];
+    // the slots can be written again
+    m_tail.storeRelease((int)(tail + n));
+    return n;
+}
+
+QVector<QtMultiSpinBoxChange> QtMultiSpinBoxJournal::drain()
+{
+    QVector<QtMultiSpinBoxChange> changes(count());
+    changes.resize(drain(changes.data(), changes.count()));
+    return changes;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,86 @@
+#ifndef QTMULTISPINBOXJOURNAL_H
+#define QTMULTISPINBOXJOURNAL_H
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QVariant>
+#include <QVector>
+
+
+QT_BEGIN_NAMESPACE
+
+// value of a section, numbers only: no allocation to copy it
+class QtMultiSpinBoxJournalValue
+{
+public:
+    enum Type { Invalid, Int, UInt, Double };
+
+    QtMultiSpinBoxJournalValue() : type(Invalid) { data.i = 0; }
+
+    static QtMultiSpinBoxJournalValue fromVariant(const QVariant& value);
+    QVariant toVariant() const;
+
+    bool operator==(const QtMultiSpinBoxJournalValue& other) const;
+    bool operator!=(const QtMultiSpinBoxJournalValue& other) const { return !(*this == other); }
+
+    Type type;
+    union {
+        qint64 i;
+        quint64 u;
+        double d;
+    } data;
+};
+
+
+// one committed change of a section
+class QtMultiSpinBoxChange
+{
+public:
+    enum Origin {
+        Edited,       // typed (at the end of the editing), stepped or pasted
+        Programmatic, // setValue, setText, setValues...
+        Derived       // output of a constraint
+    };
+
+    QtMultiSpinBoxChange() : timestamp(0), section(-1), origin(Edited) {}
+
+    qint64 timestamp; // ms since epoch, UTC
+    int section;
+    Origin origin;
+    QtMultiSpinBoxJournalValue oldValue;
+    QtMultiSpinBoxJournalValue newValue;
+};
+
+
+// Fixed capacity ring buffer of changes: written by the widget thread
+// without lock nor allocation, drained from any thread.
+// When full, the new changes are dropped (and counted), never the old ones.
+class QtMultiSpinBoxJournal
+{
+public:
+    explicit QtMultiSpinBoxJournal(int capacity);
+
+    int capacity() const { return m_records.count(); }
+    int count() const;   // waiting to be drained
+    int dropped() const; // lost because the journal was full
+
+    // widget thread only
+    bool append(const QtMultiSpinBoxChange& change);
+
+    // any thread, oldest first
+    int drain(QtMultiSpinBoxChange* changes, int maxCount);
+    QVector<QtMultiSpinBoxChange> drain();
+
+private:
+    Q_DISABLE_COPY(QtMultiSpinBoxJournal)
+
+    QVector<QtMultiSpinBoxChange> m_records;
+    QAtomicInt m_head; // written, wraps around
+    QAtomicInt m_tail; // drained, wraps around
+    QAtomicInt m_dropped;
+    QMutex m_drainMutex;
+};
+
+QT_END_NAMESPACE
+
+#endif // QTMULTISPINBOXJOURNAL_H
@@ -0,0 +1,102 @@
+#include "qtmultispinboxlayouts.h"
+
+#include "qtmultispinboxelements.h"
+
+
+QT_BEGIN_NAMESPACE
+
+// single pass over "<prefix>f0<sep>f1<sep>...", fields are 8 bits wide
+static bool qmsbParseFields(const QString& text, int from, int count, int radix, QChar separator, quint64& result)
+{
+    result = 0;
+    const QChar* c = text.constData() + from;
+    const QChar* end = text.constData() + text.length();
+    for (int field=0; field < count; field++) {
+        if (field > 0) {
+            if (c == end || *c != separator)
+                return false;
+            ++c;
+        }
+        uint v = 0;
+        int digits = 0;
+        for (int d; c != end && (d = QtRadixMultiSpinBoxElement::digitValue(*c, radix)) >= 0; ++c, ++digits) {
+            v = v * radix + d;
+            if (v > 0xFF)
+                return false;
+        }
+        if (digits == 0)
+            return false;
+        result = (result << 8) | v;
+    }
+    return c == end;
+}
+
+// all fields in one text update (journaled like setValues)
+static void qmsbSetFields(QtMultiSpinBox* spin, quint64 fields)
+{
+    const int count = spin->count();
+    QVariantList values;
+    values.reserve(count);
+    for (int i=0; i < count; i++)
+        values.append(QVariant((fields >> (8 * (count - i - 1))) & 0xFF));
+    spin->setValues(values);
+}
+
+
+//==============================================================================
+
+
+QtIPv4MultiSpinBox::QtIPv4MultiSpinBox(QWidget *parent) :
+    QtMultiSpinBox(parent)
+{
+    setObjectName(QLatin1String("QtIPv4MultiSpinBox"));
+
+    for (int i=0; i < 4; i++) {
+        QtRadixMultiSpinBoxElement* e = new QtRadixMultiSpinBoxElement(10, 0, 255, 0, this);
+        e->setZeroPadded(false);
+        appendSpinElement(e, (i < 3) ? QLatin1String(".") : QLatin1String(""));
+    }
+}
+
+quint32 QtIPv4MultiSpinBox::address() const
+{
+    quint64 fields = 0;
+    if (count() != 4 || !qmsbParseFields(text(), prefix().length(), 4, 10, QLatin1Char('.'), fields))
+        return 0;
+    return (quint32)fields;
+}
+
+void QtIPv4MultiSpinBox::setAddress(quint32 address)
+{
+    qmsbSetFields(this, address);
+}
+
+
+//==============================================================================
+
+
+QtMacMultiSpinBox::QtMacMultiSpinBox(QWidget *parent, QChar separator) :
+    QtMultiSpinBox(parent)
+{
+    setObjectName(QLatin1String("QtMacMultiSpinBox"));
+
+    for (int i=0; i < 6; i++) {
+        QtRadixMultiSpinBoxElement* e = new QtRadixMultiSpinBoxElement(16, 0, 0xFF, 2, this);
+        appendSpinElement(e, (i < 5) ? QString(separator) : QString());
+    }
+}
+
+quint64 QtMacMultiSpinBox::address() const
+{
+    quint64 fields = 0;
+    if (count() != 6 || !qmsbParseFields(text(), prefix().length(), 6, 16, suffix(0).at(0), fields))
+        return 0;
+    return fields;
+}
+
+void QtMacMultiSpinBox::setAddress(quint64 address)
+{
+    qmsbSetFields(this, address & Q_UINT64_C(0xFFFFFFFFFFFF));
+}
+
+QT_END_NAMESPACE
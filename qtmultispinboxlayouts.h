@@ -0,0 +1,43 @@
+#ifndef QTMULTISPINBOXLAYOUTS_H
+#define QTMULTISPINBOXLAYOUTS_H
+
+#include "qtmultispinbox.h"
+
+
+QT_BEGIN_NAMESPACE
+
+
+// ready-made "192.168.0.1" spin box (4 decimal octets)
+class QtIPv4MultiSpinBox : public QtMultiSpinBox
+{
+    Q_OBJECT
+    Q_PROPERTY(quint32 address READ address WRITE setAddress)
+
+public:
+    explicit QtIPv4MultiSpinBox(QWidget *parent = 0);
+
+    quint32 address() const; // host byte order, 0 if the text is not complete
+
+public Q_SLOTS:
+    void setAddress(quint32 address);
+};
+
+
+// ready-made "00:1A:2B:3C:4D:5E" spin box (6 hexadecimal bytes)
+class QtMacMultiSpinBox : public QtMultiSpinBox
+{
+    Q_OBJECT
+    Q_PROPERTY(quint64 address READ address WRITE setAddress)
+
+public:
+    explicit QtMacMultiSpinBox(QWidget *parent = 0, QChar separator = QLatin1Char(':'));
+
+    quint64 address() const; // 48 lower bits, 0 if the text is not complete
+
+public Q_SLOTS:
+    void setAddress(quint64 address);
+};
+
+QT_END_NAMESPACE
+
+#endif // QTMULTISPINBOXLAYOUTS_H
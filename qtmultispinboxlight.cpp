@@ -0,0 +1,262 @@
+#include "qtmultispinboxlight.h"
+
+#include <QApplication>
+#include <QFocusEvent>
+#include <QLineEdit>
+#include <QMouseEvent>
+#include <QPointer>
+#include <QStyleOptionSpinBox>
+#include <QStylePainter>
+
+#include "qtmultispinboxelements.h"
+
+
+QT_BEGIN_NAMESPACE
+
+// one editor for all the light spin boxes of the GUI thread
+static QPointer<QtMultiSpinBox> qmsbSharedEditor;
+static QPointer<QtLightMultiSpinBox> qmsbEditorOwner;
+// the focus went back from the editor to its owner (backtab)
+static bool qmsbSkipFocusIn = false;
+
+
+QtLightMultiSpinBox::QtLightMultiSpinBox(QWidget *parent) :
+    QWidget(parent)
+{
+    setObjectName(QLatin1String("QtLightMultiSpinBox"));
+    setFocusPolicy(Qt::WheelFocus);
+    setAttribute(Qt::WA_InputMethodEnabled);
+    setSizePolicy(QSizePolicy::Minimum, QSizePolicy::Fixed);
+}
+
+QtLightMultiSpinBox::~QtLightMultiSpinBox()
+{
+    // the elements go back to this one, the editor is deleted with its parent
+    if (isEditing())
+        endEdit();
+}
+
+
+void QtLightMultiSpinBox::appendSpinElement(QtMultiSpinBoxElement* element, const QString &suffix)
+{
+    Q_ASSERT(element != NULL);
+    // same rules and whitespaces than QtMultiSpinBox
+    Q_ASSERT(count() == 0 || !m_engine.suffix(count()-1).isEmpty());
+    if (isEditing())
+        endEdit();
+    m_engine.appendElement(element, suffix);
+    m_values.append(element->defaultValue());
+    updateGeometry();
+    update();
+}
+
+QString QtLightMultiSpinBox::suffix(int index) const
+{
+    Q_ASSERT(index >= 0 && index < count());
+    return m_engine.suffix(index);
+}
+
+void QtLightMultiSpinBox::setPrefix(const QString& prefix)
+{
+    m_engine.setPrefix(prefix);
+    if (isEditing())
+        editor()->setPrefix(m_engine.prefix());
+    updateGeometry();
+    update();
+}
+
+QString QtLightMultiSpinBox::text() const
+{
+    if (isEditing())
+        return editor()->text();
+    return m_engine.text(m_values);
+}
+
+
+QVariant QtLightMultiSpinBox::value(int index) const
+{
+    Q_ASSERT(index >= 0 && index < count());
+    if (isEditing())
+        return editor()->value(index);
+    return m_values.at(index);
+}
+
+QVariantList QtLightMultiSpinBox::values() const
+{
+    if (isEditing())
+        return editor()->values();
+    return m_values;
+}
+
+void QtLightMultiSpinBox::setValue(int index, const QVariant& value)
+{
+    Q_ASSERT(index >= 0 && index < count());
+    QVariantList v = values();
+    v[index] = value;
+    setValues(v);
+}
+
+void QtLightMultiSpinBox::setValues(const QVariantList& values)
+{
+    if (isEditing()) {
+        editor()->setValues(values);
+        return; // valuesChanged from the editor
+    }
+    bool changed = false;
+    for (int i=0; i < values.count() && i < m_values.count(); i++) {
+        if (values.at(i).isValid() && values.at(i) != m_values.at(i)) {
+            m_values[i] = values.at(i);
+            changed = true;
+        }
+    }
+    if (changed) {
+        update();
+        Q_EMIT valuesChanged();
+    }
+}
+
+
+bool QtLightMultiSpinBox::isEditing() const
+{
+    return qmsbEditorOwner == this && qmsbSharedEditor;
+}
+
+QtMultiSpinBox* QtLightMultiSpinBox::editor() const
+{
+    return isEditing() ? qmsbSharedEditor.data() : 0;
+}
+
+void QtLightMultiSpinBox::beginEdit()
+{
+    if (isEditing())
+        return;
+    if (qmsbEditorOwner)
+        qmsbEditorOwner->endEdit();
+
+    if (!qmsbSharedEditor)
+        qmsbSharedEditor = new QtMultiSpinBox(this);
+    QtMultiSpinBox* e = qmsbSharedEditor.data();
+    if (e->parentWidget() != this)
+        e->setParent(this);
+    qmsbEditorOwner = this;
+
+    // lend the layout, the text is built while hidden
+    e->setPrefix(m_engine.prefix());
+    for (int i=0; i < count(); i++)
+        e->appendSpinElement(m_engine.element(i), m_engine.suffix(i));
+    e->setValues(m_values);
+    e->setFont(font());
+    e->setGeometry(rect());
+
+    connect(e, SIGNAL(editingFinished()), this, SLOT(editorEditingFinished()));
+    connect(e, SIGNAL(valuesChanged()), this, SIGNAL(valuesChanged()));
+    e->show();
+    e->setFocus(Qt::OtherFocusReason);
+}
+
+void QtLightMultiSpinBox::endEdit()
+{
+    if (!isEditing())
+        return;
+    QtMultiSpinBox* e = qmsbSharedEditor.data();
+    disconnect(e, 0, this, 0);
+
+    // typed values back, elements given back
+    const QVariantList v = e->values();
+    for (int i=0; i < v.count() && i < m_values.count(); i++) {
+        if (v.at(i).isValid())
+            m_values[i] = v.at(i);
+    }
+    e->hide();
+    for (int i = e->count()-1; i >= 0; i--)
+        e->takeSpinElement(i);
+    e->setPrefix(QString());
+    qmsbEditorOwner = 0;
+    update();
+}
+
+void QtLightMultiSpinBox::editorEditingFinished()
+{
+    // Return keeps editing, leaving the editor ends it
+    QtMultiSpinBox* e = editor();
+    if (!e || e->hasFocus())
+        return;
+    qmsbSkipFocusIn = (QApplication::focusWidget() == this);
+    endEdit();
+}
+
+
+QSize QtLightMultiSpinBox::sizeHint() const
+{
+    ensurePolished();
+    const QFontMetrics fm(fontMetrics());
+    // like QAbstractSpinBox, with the text and a cursor
+    QSize hint(qmsbHorizontalAdvance(fm, text() + QLatin1Char(' ')) + 4, qMax(fm.height(), 14) + 2);
+    QStyleOptionSpinBox opt;
+    opt.initFrom(this);
+    opt.frame = true;
+    opt.subControls = QStyle::SC_SpinBoxFrame | QStyle::SC_SpinBoxEditField
+            | QStyle::SC_SpinBoxUp | QStyle::SC_SpinBoxDown;
+    return style()->sizeFromContents(QStyle::CT_SpinBox, &opt, hint, this);
+}
+
+QSize QtLightMultiSpinBox::minimumSizeHint() const
+{
+    return sizeHint();
+}
+
+
+void QtLightMultiSpinBox::paintEvent(QPaintEvent*)
+{
+    if (isEditing())
+        return;
+    QStylePainter p(this);
+    QStyleOptionSpinBox opt;
+    opt.initFrom(this);
+    opt.frame = true;
+    opt.buttonSymbols = QAbstractSpinBox::UpDownArrows;
+    opt.stepEnabled = (count() == 0) ? QAbstractSpinBox::StepNone
+                                           : (QAbstractSpinBox::StepUpEnabled | QAbstractSpinBox::StepDownEnabled);
+    opt.subControls = QStyle::SC_SpinBoxFrame | QStyle::SC_SpinBoxUp | QStyle::SC_SpinBoxDown;
+    p.drawComplexControl(QStyle::CC_SpinBox, opt);
+
+    QRect field = style()->subControlRect(QStyle::CC_SpinBox, &opt, QStyle::SC_SpinBoxEditField, this);
+    p.setPen(palette().color(isEnabled() ? QPalette::Active : QPalette::Disabled, QPalette::Text));
+    p.drawText(field, Qt::AlignCenter, text());
+}
+
+void QtLightMultiSpinBox::resizeEvent(QResizeEvent* event)
+{
+    if (isEditing())
+        editor()->setGeometry(rect());
+    QWidget::resizeEvent(event);
+}
+
+void QtLightMultiSpinBox::focusInEvent(QFocusEvent* event)
+{
+    QWidget::focusInEvent(event);
+    if (qmsbSkipFocusIn) {
+        qmsbSkipFocusIn = false;
+        focusNextPrevChild(false);
+        return;
+    }
+    if (event->reason() != Qt::MouseFocusReason)
+        beginEdit();
+}
+
+void QtLightMultiSpinBox::mousePressEvent(QMouseEvent* event)
+{
+    beginEdit();
+    // the click places the cursor in the editor
+    QLineEdit* edit = isEditing() ? editor()->findChild<QLineEdit*>() : 0;
+    if (edit && event->button() == Qt::LeftButton) {
+        QPoint pos = edit->mapFrom(this, event->pos());
+        QMouseEvent press(QEvent::MouseButtonPress, pos, event->button(), event->buttons(), event->modifiers());
+        QApplication::sendEvent(edit, &press);
+        QMouseEvent release(QEvent::MouseButtonRelease, pos, event->button(), Qt::NoButton, event->modifiers());
+        QApplication::sendEvent(edit, &release);
+    }
+    event->accept();
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,74 @@
+#ifndef QTMULTISPINBOXLIGHT_H
+#define QTMULTISPINBOXLIGHT_H
+
+#include <QStringList>
+#include <QVariant>
+#include <QWidget>
+
+#include "qtmultispinbox.h"
+
+
+QT_BEGIN_NAMESPACE
+
+// Lightweight spin box for large forms: the values are kept typed and the
+// formatted text is painted, without any line edit. On focus (tab, click...)
+// it borrows a QtMultiSpinBox shared by all of them, lends it its elements,
+// and takes the values back when the focus leaves.
+// The elements are not owned (like QtMultiSpinBox).
+class QtLightMultiSpinBox : public QWidget
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ count)
+    Q_PROPERTY(QString prefix READ prefix WRITE setPrefix)
+    Q_PROPERTY(QVariantList values READ values WRITE setValues NOTIFY valuesChanged USER true)
+
+public:
+    explicit QtLightMultiSpinBox(QWidget *parent = 0);
+    virtual ~QtLightMultiSpinBox();
+
+    void appendSpinElement(QtMultiSpinBoxElement* element, const QString &suffix = QString());
+
+    int count() const { return m_engine.count(); }
+    QString prefix() const { return m_engine.prefix(); }
+    QString suffix(int index) const;
+    QString text() const; // formatted
+
+    QVariant value(int index) const;
+    QVariantList values() const;
+
+    bool isEditing() const; // the shared spin box is lent to this one
+    QtMultiSpinBox* editor() const; // 0 if not editing
+
+    QSize sizeHint() const;
+    QSize minimumSizeHint() const;
+
+public Q_SLOTS:
+    void setPrefix(const QString& prefix);
+    void setValue(int index, const QVariant& value);
+    void setValues(const QVariantList& values);
+
+    void beginEdit();
+    void endEdit(); // values taken back from the editor
+
+Q_SIGNALS:
+    void valuesChanged();
+
+protected:
+    void paintEvent(QPaintEvent* event);
+    void resizeEvent(QResizeEvent* event);
+    void focusInEvent(QFocusEvent* event);
+    void mousePressEvent(QMouseEvent* event);
+
+private Q_SLOTS:
+    void editorEditingFinished();
+
+private:
+    Q_DISABLE_COPY(QtLightMultiSpinBox)
+
+    QtMultiSpinBoxEngine m_engine; // layout, the elements are not owned
+    QVariantList m_values; // typed, one per element
+};
+
+QT_END_NAMESPACE
+
+#endif // QTMULTISPINBOXLIGHT_H
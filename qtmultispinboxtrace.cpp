@@ -0,0 +1,164 @@
+#include "qtmultispinboxtrace.h"
+
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThread>
+
+#include <atomic>
+
+
+QT_BEGIN_NAMESPACE
+
+#ifdef QTMULTISPINBOX_TRACE
+
+namespace {
+
+// power of 2
+const int qmsbTraceCapacity = 1 << 16;
+
+// seqlock: the payload is read while another lap may write it, hence
+// relaxed atomics ordered by the fences around them
+struct QtMultiSpinBoxTraceEvent
+{
+    QAtomicInt ticket; // qmsbTraceStamp(ticket) once written, qmsbTraceWriting while writing
+    std::atomic<const char*> name;
+    std::atomic<qint64> start;
+    std::atomic<qint64> duration;
+    std::atomic<quintptr> thread;
+};
+
+QtMultiSpinBoxTraceEvent qmsbTraceEvents[qmsbTraceCapacity];
+QAtomicInt qmsbTraceNextTicket;
+
+// reserved: never a stamp of a ticket
+const int qmsbTraceWriting = 0;
+
+// in [1, 2^31], also once the tickets wrap around
+inline int qmsbTraceStamp(uint ticket)
+{
+    return (int)((ticket & 0x7FFFFFFFu) + 1u);
+}
+
+const QElapsedTimer& qmsbTraceClock()
+{
+    static QElapsedTimer clock;
+    static bool started = (clock.start(), true);
+    Q_UNUSED(started);
+    return clock;
+}
+
+}
+
+#endif
+
+
+bool QtMultiSpinBoxTrace::isEnabled()
+{
+#ifdef QTMULTISPINBOX_TRACE
+    return true;
+#else
+    return false;
+#endif
+}
+
+int QtMultiSpinBoxTrace::capacity()
+{
+#ifdef QTMULTISPINBOX_TRACE
+    return qmsbTraceCapacity;
+#else
+    return 0;
+#endif
+}
+
+qint64 QtMultiSpinBoxTrace::nowNs()
+{
+#ifdef QTMULTISPINBOX_TRACE
+    return qmsbTraceClock().nsecsElapsed();
+#else
+    return 0;
+#endif
+}
+
+void QtMultiSpinBoxTrace::record(const char* name, qint64 startNs, qint64 durationNs)
+{
+#ifdef QTMULTISPINBOX_TRACE
+    int ticket = qmsbTraceNextTicket.fetchAndAddRelaxed(1);
+    QtMultiSpinBoxTraceEvent& e = qmsbTraceEvents[ticket & (qmsbTraceCapacity - 1)];
+    e.ticket.storeRelease(qmsbTraceWriting);
+    // the payload stores are not moved before the marker
+    std::atomic_thread_fence(std::memory_order_release);
+    e.name.store(name, std::memory_order_relaxed);
+    e.start.store(startNs, std::memory_order_relaxed);
+    e.duration.store(durationNs, std::memory_order_relaxed);
+    e.thread.store(reinterpret_cast<quintptr>(QThread::currentThreadId()), std::memory_order_relaxed);
+    e.ticket.storeRelease(qmsbTraceStamp((uint)ticket));
+#else
+    Q_UNUSED(name);
+    Q_UNUSED(startNs);
+    Q_UNUSED(durationNs);
+#endif
+}
+
+void QtMultiSpinBoxTrace::clear()
+{
+#ifdef QTMULTISPINBOX_TRACE
+    for (int i=0; i < qmsbTraceCapacity; i++)
+        qmsbTraceEvents[i].ticket.storeRelease(qmsbTraceWriting);
+    qmsbTraceNextTicket.storeRelease(0);
+#endif
+}
+
+QByteArray QtMultiSpinBoxTrace::toJson()
+{
+    QByteArray json("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+#ifdef QTMULTISPINBOX_TRACE
+    const QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+    // tickets wrap around, unsigned arithmetic keeps the last ones
+    const uint end = (uint)qmsbTraceNextTicket.loadAcquire();
+    const uint count = qMin(end, (uint)qmsbTraceCapacity);
+    bool first = true;
+    for (uint ticket = end - count; ticket != end; ticket++) {
+        const QtMultiSpinBoxTraceEvent& e = qmsbTraceEvents[ticket & (qmsbTraceCapacity - 1)];
+        const int expected = qmsbTraceStamp(ticket);
+        // skip spans being written or already overwritten
+        if (e.ticket.loadAcquire() != expected)
+            continue;
+        const char* name = e.name.load(std::memory_order_relaxed);
+        qint64 start = e.start.load(std::memory_order_relaxed);
+        qint64 duration = e.duration.load(std::memory_order_relaxed);
+        quintptr thread = e.thread.load(std::memory_order_relaxed);
+        // the payload reads are not moved after the second check
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (e.ticket.loadAcquire() != expected)
+            continue;
+        if (!first)
+            json += ',';
+        first = false;
+        json += "\n{\"name\":\"";
+        json += name;
+        json += "\",\"cat\":\"QtMultiSpinBox\",\"ph\":\"X\",\"ts\":";
+        json += QByteArray::number(start / 1000.0, 'f', 3);
+        json += ",\"dur\":";
+        json += QByteArray::number(duration / 1000.0, 'f', 3);
+        json += ",\"pid\":";
+        json += pid;
+        json += ",\"tid\":";
+        json += QByteArray::number((qulonglong)thread);
+        json += '}';
+    }
+#endif
+    json += "\n]}\n";
+    return json;
+}
+
+bool QtMultiSpinBoxTrace::save(const QString& fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    return file.write(toJson()) >= 0;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,62 @@
+#ifndef QTMULTISPINBOXTRACE_H
+#define QTMULTISPINBOXTRACE_H
+
+#include <QByteArray>
+#include <QString>
+
+
+QT_BEGIN_NAMESPACE
+
+// In-memory trace of the spin box hot paths, enabled with
+// CONFIG += multispinbox_trace (see multispinbox.pri).
+// Spans are written in a fixed ring buffer without lock nor allocation,
+// the oldest spans are overwritten.
+class QtMultiSpinBoxTrace
+{
+public:
+    static bool isEnabled();
+    static int capacity();
+
+    static void clear(); // not while spans are recorded by another thread
+
+    // Chrome/Perfetto trace JSON (chrome://tracing, ui.perfetto.dev)
+    static QByteArray toJson();
+    static bool save(const QString& fileName);
+
+    // name must be a string literal (only the pointer is kept)
+    static void record(const char* name, qint64 startNs, qint64 durationNs);
+    static qint64 nowNs();
+};
+
+
+class QtMultiSpinBoxTraceScope
+{
+public:
+    explicit QtMultiSpinBoxTraceScope(const char* name) :
+        m_name(name),
+        m_start(QtMultiSpinBoxTrace::nowNs())
+    {
+    }
+
+    ~QtMultiSpinBoxTraceScope()
+    {
+        QtMultiSpinBoxTrace::record(m_name, m_start, QtMultiSpinBoxTrace::nowNs() - m_start);
+    }
+
+private:
+    Q_DISABLE_COPY(QtMultiSpinBoxTraceScope)
+
+    const char* m_name;
+    qint64 m_start;
+};
+
+QT_END_NAMESPACE
+
+
+#ifdef QTMULTISPINBOX_TRACE
+#define QMSBTRACE(NAME) QtMultiSpinBoxTraceScope qmsbTraceScope(NAME)
+#else
+#define QMSBTRACE(NAME) do {} while (false)
+#endif
+
+#endif // QTMULTISPINBOXTRACE_H